@@ -0,0 +1,238 @@
+#include "latency_measurer.h"
+
+#include <juce_dsp/juce_dsp.h>
+
+LatencyMeasurer::LatencyMeasurer() = default;
+
+LatencyMeasurer::~LatencyMeasurer() {
+    stopTimer();
+    cancelPendingUpdate();
+}
+
+void LatencyMeasurer::start(std::function<void(const Result&)> onComplete) {
+    if (isRunning()) return;
+
+    completionCallback = std::move(onComplete);
+    prepare(sampleRate);
+    position = 0;
+    aborted.store(false);
+    state.store(State::armed);
+
+    auto recordingMs = 1000.0 * recording.getNumSamples() / sampleRate;
+    startTimer(juce::roundToInt(recordingMs) + timeoutMarginMs);
+}
+
+void LatencyMeasurer::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+
+    // fixed seed, so every run plays the same burst
+    juce::Random random(0x4d4152);
+    testSignal.setSize(1, signalLength);
+    for (int i = 0; i < signalLength; ++i) {
+        auto window = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * i / signalLength);
+        testSignal.setSample(0, i, (random.nextFloat() * 2.0f - 1.0f) * window * 0.5f);
+    }
+
+    recording.setSize(1, signalLength + static_cast<int>(sampleRate * maxLatencySeconds));
+    recording.clear();
+}
+
+void LatencyMeasurer::audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
+    int numInputChannels,
+    float* const* outputChannelData,
+    int numOutputChannels,
+    int numSamples,
+    const juce::AudioIODeviceCallbackContext&) {
+    for (int channel = 0; channel < numOutputChannels; ++channel) {
+        if (outputChannelData[channel] != nullptr) {
+            juce::FloatVectorOperations::clear(outputChannelData[channel], numSamples);
+        }
+    }
+
+    auto current = state.load();
+    if (current == State::armed) {
+        state.store(State::recording);
+    } else if (current != State::recording) {
+        return;
+    }
+
+    const int count = juce::jmin(numSamples, recording.getNumSamples() - position);
+
+    if (numInputChannels > 0 && inputChannelData[0] != nullptr) {
+        recording.copyFrom(0, position, inputChannelData[0], count);
+    }
+
+    if (position < signalLength) {
+        const int toPlay = juce::jmin(count, signalLength - position);
+        for (int channel = 0; channel < numOutputChannels; ++channel) {
+            if (outputChannelData[channel] != nullptr) {
+                juce::FloatVectorOperations::copy(
+                    outputChannelData[channel], testSignal.getReadPointer(0, position), toPlay);
+            }
+        }
+    }
+
+    position += count;
+    if (position >= recording.getNumSamples()) {
+        state.store(State::analysing);
+        triggerAsyncUpdate();
+    }
+}
+
+void LatencyMeasurer::audioDeviceAboutToStart(juce::AudioIODevice* device) {
+    sampleRate = device->getCurrentSampleRate();
+    reportedLatencySamples =
+        device->getInputLatencyInSamples() + device->getOutputLatencyInSamples();
+}
+
+void LatencyMeasurer::audioDeviceStopped() {
+    // a measurement interrupted by a device change is worthless, report it as failed
+    auto current = state.load();
+    if (current == State::armed || current == State::recording) {
+        aborted.store(true);
+        state.store(State::analysing);
+        triggerAsyncUpdate();
+    }
+}
+
+LatencyMeasurer::Result LatencyMeasurer::analyse() const {
+    Result result;
+    result.reportedLatencySamples = reportedLatencySamples;
+
+    const int recordedLength = recording.getNumSamples();
+    const int fftOrder = juce::roundToInt(
+        std::ceil(std::log2(static_cast<double>(recordedLength + signalLength))));
+    const int fftSize = 1 << fftOrder;
+
+    juce::dsp::FFT fft(fftOrder);
+    std::vector<juce::dsp::Complex<float>> recorded(fftSize), reference(fftSize);
+    std::vector<juce::dsp::Complex<float>> recordedSpectrum(fftSize), referenceSpectrum(fftSize);
+
+    for (int i = 0; i < recordedLength; ++i) recorded[i] = recording.getSample(0, i);
+    for (int i = 0; i < signalLength; ++i) reference[i] = testSignal.getSample(0, i);
+
+    fft.perform(recorded.data(), recordedSpectrum.data(), false);
+    fft.perform(reference.data(), referenceSpectrum.data(), false);
+
+    for (int i = 0; i < fftSize; ++i) {
+        recordedSpectrum[i] *= std::conj(referenceSpectrum[i]);
+    }
+
+    // reuse the time domain buffer for the cross-correlation
+    fft.perform(recordedSpectrum.data(), recorded.data(), true);
+
+    // only lags where the whole burst fits into the recording are meaningful
+    const int maxLag = recordedLength - signalLength;
+    int bestLag = 0;
+    float bestValue = 0.0f;
+    for (int lag = 0; lag <= maxLag; ++lag) {
+        auto value = std::abs(recorded[lag].real());
+        if (value > bestValue) {
+            bestValue = value;
+            bestLag = lag;
+        }
+    }
+
+    // normalise in the time domain so the result doesn't depend on the FFT scaling
+    auto* ref = testSignal.getReadPointer(0);
+    auto* rec = recording.getReadPointer(0, bestLag);
+    double dot = 0.0, referenceEnergy = 0.0, recordedEnergy = 0.0;
+    for (int i = 0; i < signalLength; ++i) {
+        dot += ref[i] * rec[i];
+        referenceEnergy += ref[i] * ref[i];
+        recordedEnergy += rec[i] * rec[i];
+    }
+
+    if (recordedEnergy <= 0.0) return result;
+
+    result.confidence =
+        static_cast<float>(std::abs(dot) / std::sqrt(referenceEnergy * recordedEnergy));
+    result.success = result.confidence > 0.3f;
+    result.latencySamples = bestLag;
+    result.latencyMs = 1000.0 * bestLag / sampleRate;
+
+    return result;
+}
+
+void LatencyMeasurer::timerCallback() {
+    stopTimer();
+
+    // no (or too few) callbacks arrived, report a failure rather than hang
+    auto current = state.load();
+    if (current == State::armed || current == State::recording) {
+        aborted.store(true);
+        state.store(State::analysing);
+        handleAsyncUpdate();
+    }
+}
+
+void LatencyMeasurer::handleAsyncUpdate() {
+    if (state.load() != State::analysing) return;
+    stopTimer();
+
+    Result result;
+    if (aborted.exchange(false)) {
+        result.aborted = true;
+    } else {
+        result = analyse();
+    }
+    state.store(State::idle);
+
+    std::cout << "Round-trip latency: " << result.latencySamples << " samples ("
+              << result.latencyMs << " ms), confidence " << result.confidence << std::endl;
+
+    if (completionCallback) completionCallback(result);
+}
+
+LatencyMeasurer::Result LatencyMeasurer::measureSoftwareLoopback(int delaySamples,
+    double sampleRate,
+    int blockSize) {
+    LatencyMeasurer measurer;
+    measurer.sampleRate = sampleRate;
+    measurer.start(nullptr);
+
+    // everything ever played, so the input can be read back delaySamples later; like a real
+    // round trip the delay must be at least one block, otherwise the input isn't known yet
+    std::vector<float> played;
+    std::vector<float> input(blockSize), output(blockSize);
+    const float* inputs[] = {input.data()};
+    float* outputs[] = {output.data()};
+
+    while (measurer.state.load() == State::armed || measurer.state.load() == State::recording) {
+        const int blockStart = static_cast<int>(played.size());
+        for (int i = 0; i < blockSize; ++i) {
+            auto readPosition = blockStart + i - delaySamples;
+            input[i] =
+                (readPosition >= 0 && readPosition < blockStart) ? played[readPosition] : 0.0f;
+        }
+
+        measurer.audioDeviceIOCallbackWithContext(inputs, 1, outputs, 1, blockSize, {});
+        played.insert(played.end(), output.begin(), output.end());
+    }
+
+    measurer.stopTimer();
+    measurer.cancelPendingUpdate();
+    auto result = measurer.analyse();
+    measurer.state.store(State::idle);
+
+    return result;
+}
+
+class LatencyMeasurerTests : public juce::UnitTest {
+   public:
+    LatencyMeasurerTests() : juce::UnitTest("LatencyMeasurer") {}
+
+    void runTest() override {
+        beginTest("Software loopback recovers the delay");
+
+        for (int blockSize : {64, 256, 480, 1024}) {
+            for (int delay : {blockSize, blockSize * 2 + 37, 3000}) {
+                auto result = LatencyMeasurer::measureSoftwareLoopback(delay, 48000.0, blockSize);
+                expect(result.success, "block size " + juce::String(blockSize));
+                expectEquals(result.latencySamples, delay, "block size " + juce::String(blockSize));
+            }
+        }
+    }
+};
+
+static LatencyMeasurerTests latencyMeasurerTests;
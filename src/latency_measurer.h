@@ -0,0 +1,79 @@
+#pragma once
+
+#include <juce_audio_devices/juce_audio_devices.h>
+
+#include <atomic>
+
+/**
+ * Measures round-trip latency by playing a noise burst on every output channel and
+ * cross-correlating it with what comes back on the first input channel. Needs a physical
+ * (or virtual) loopback from any output to the first input while it runs.
+ */
+class LatencyMeasurer : public juce::AudioIODeviceCallback,
+                        private juce::AsyncUpdater,
+                        private juce::Timer {
+   public:
+    struct Result {
+        bool success = false;
+        // the device stopped or stopped delivering callbacks, nothing was analysed
+        bool aborted = false;
+        int latencySamples = 0;
+        double latencyMs = 0.0;
+        // normalized correlation peak, close to 1 for a clean loopback
+        float confidence = 0.0f;
+        // input + output latency reported by the driver, for comparison
+        int reportedLatencySamples = 0;
+    };
+
+    LatencyMeasurer();
+    ~LatencyMeasurer() override;
+
+    /**
+     * Arms a new measurement. It starts with the next audio callback; the result is
+     * delivered on the message thread. If the device stops delivering callbacks, the
+     * measurement fails after a timeout instead of waiting forever.
+     */
+    void start(std::function<void(const Result&)> onComplete);
+    bool isRunning() const { return state.load() != State::idle; }
+
+    /**
+     * Runs a measurement through a software delay line instead of an audio device, so the
+     * signal and correlation path can be checked without hardware. The delay has to be at least
+     * one block, like any real round trip. Covered by the "LatencyMeasurer" unit test.
+     */
+    static Result measureSoftwareLoopback(int delaySamples, double sampleRate, int blockSize);
+
+    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
+        int numInputChannels,
+        float* const* outputChannelData,
+        int numOutputChannels,
+        int numSamples,
+        const juce::AudioIODeviceCallbackContext& context) override;
+    void audioDeviceAboutToStart(juce::AudioIODevice* device) override;
+    void audioDeviceStopped() override;
+
+   private:
+    enum class State { idle, armed, recording, analysing };
+
+    static constexpr int signalLength = 8192;
+    static constexpr double maxLatencySeconds = 0.5;
+    static constexpr int timeoutMarginMs = 2000;
+
+    std::atomic<State> state{State::idle};
+    std::atomic<bool> aborted{false};
+    std::function<void(const Result&)> completionCallback;
+
+    double sampleRate = 44100.0;
+    int reportedLatencySamples = 0;
+
+    juce::AudioBuffer<float> testSignal;
+    juce::AudioBuffer<float> recording;
+    int position = 0;
+
+    void prepare(double newSampleRate);
+    Result analyse() const;
+    void handleAsyncUpdate() override;
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LatencyMeasurer)
+};
@@ -8,7 +8,22 @@ class MicAudioRackApplication : public juce::JUCEApplication {
     const juce::String getApplicationVersion() override { return "0.1.0"; }
     bool moreThanOneInstanceAllowed() override { return true; }
 
-    void initialise(const juce::String&) override {
+    void initialise(const juce::String& commandLine) override {
+        // runs the registered unit tests instead of opening the window
+        if (commandLine.contains("--self-test")) {
+            juce::UnitTestRunner runner;
+            runner.runAllTests();
+
+            int failures = 0;
+            for (int i = 0; i < runner.getNumResults(); ++i) {
+                failures += runner.getResult(i)->failures;
+            }
+
+            setApplicationReturnValue(failures > 0 ? 1 : 0);
+            quit();
+            return;
+        }
+
         mainWindow.reset(new MainWindow("MicAudioRack", new MainComponent(), *this));
     }
 
@@ -19,7 +19,7 @@ MainComponent::MainComponent() {
 
     // initialize the plugin host (plugin chain manager)
     this->pluginHost = std::make_unique<PluginHost>();
-    audioPlayer.setProcessor(this->pluginHost->getGraph());
+    audioPlayer.setProcessor(this->pluginHost->getProcessor());
 
     // Create UI and plugin entries
 
@@ -57,9 +57,23 @@ MainComponent::MainComponent() {
     pluginChainUI = std::make_unique<PluginChainUI>(*pluginHost);
     addAndMakeVisible(pluginChainUI.get());
 
+    backendBox.setTextWhenNothingSelected("Select audio backend");
     inputDeviceBox.setTextWhenNothingSelected("Select input device");
     outputDeviceBox.setTextWhenNothingSelected("Select output device");
+    sampleRateBox.setTextWhenNothingSelected("Sample rate");
+    bufferSizeBox.setTextWhenNothingSelected("Buffer size");
+
+    // item id is the internal block size + 1, so "Device blocks" maps to 0
+    internalBlockBox.addItem("Device blocks", 1);
+    for (int size : {16, 32, 64, 128, 256, 512, 1024}) {
+        internalBlockBox.addItem("Fixed " + juce::String(size), size + 1);
+    }
+    internalBlockBox.setSelectedId(
+        pluginHost->getInternalBlockSize() + 1, juce::dontSendNotification);
+    measureLatencyButton.setButtonText("Measure latency");
+    latencyLabel.setText("Round-trip latency: -", juce::dontSendNotification);
     monoToggle.setButtonText("Force mono");
+    traceButton.setButtonText("Record trace");
 
     gainSlider.setRange(0.0, 2.0, 0.01);
     gainSlider.setValue(1.0);
@@ -69,31 +83,65 @@ MainComponent::MainComponent() {
         pluginHost->setMasterGainDecibels(juce::Decibels::gainToDecibels(gain));
     };
 
+    for (int i = 0; i < PluginHost::numChainSlots; ++i) {
+        chainBox.addItem("Chain " + juce::String(i + 1), i + 1);
+    }
+    chainBox.setSelectedItemIndex(pluginHost->getEditedChain(), juce::dontSendNotification);
+
+    crossfadeSlider.setRange(0.0, 500.0, 1.0);
+    crossfadeSlider.setValue(20.0, juce::dontSendNotification);
+    crossfadeSlider.setTextValueSuffix(" ms fade");
+    crossfadeSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 80, 20);
+    crossfadeSlider.onValueChange = [this]() {
+        pluginHost->setChainCrossfadeMilliseconds(static_cast<float>(crossfadeSlider.getValue()));
+    };
+    pluginHost->setChainCrossfadeMilliseconds(static_cast<float>(crossfadeSlider.getValue()));
+    updateChainControls();
+
+    addAndMakeVisible(backendBox);
     addAndMakeVisible(inputDeviceBox);
     addAndMakeVisible(outputDeviceBox);
+    addAndMakeVisible(sampleRateBox);
+    addAndMakeVisible(bufferSizeBox);
+    addAndMakeVisible(internalBlockBox);
+    addAndMakeVisible(measureLatencyButton);
+    addAndMakeVisible(latencyLabel);
     addAndMakeVisible(monoToggle);
+    addAndMakeVisible(traceButton);
     addAndMakeVisible(gainSlider);
+    addAndMakeVisible(chainBox);
+    addAndMakeVisible(chainLatencyLabel);
+    addAndMakeVisible(crossfadeSlider);
+    addAndMakeVisible(goLiveButton);
 
+    backendBox.addListener(this);
     inputDeviceBox.addListener(this);
     outputDeviceBox.addListener(this);
+    sampleRateBox.addListener(this);
+    bufferSizeBox.addListener(this);
+    internalBlockBox.addListener(this);
+    measureLatencyButton.addListener(this);
     monoToggle.addListener(this);
+    traceButton.addListener(this);
+    chainBox.addListener(this);
+    goLiveButton.addListener(this);
 
-    // select first audio backend
-    auto* type = deviceManager.getAvailableDeviceTypes()[0];
-    type->scanForDevices();
-
-    auto inputDevices = type->getDeviceNames(true);
-    auto outputDevices = type->getDeviceNames(false);
-
-    for (int i = 0; i < inputDevices.size(); ++i) inputDeviceBox.addItem(inputDevices[i], i + 1);
-
-    for (int i = 0; i < outputDevices.size(); ++i) outputDeviceBox.addItem(outputDevices[i], i + 1);
+    // the device manager has already scanned every backend while initialising
+    for (auto* type : deviceManager.getAvailableDeviceTypes()) {
+        backendBox.addItem(type->getTypeName(), backendBox.getNumItems() + 1);
+    }
 
-    updateAudioDevice();
+    populateDeviceLists();
+    populateDeviceFormats();
+    deviceManager.addChangeListener(this);
+    pluginHost->addChangeListener(this);
 }
 
 MainComponent::~MainComponent() {
     std::cout << "Destructor called" << std::endl;
+    deviceManager.removeChangeListener(this);
+    pluginHost->removeChangeListener(this);
+    deviceManager.removeAudioCallback(&latencyMeasurer);
     audioPlayer.setProcessor(nullptr);
     deviceManager.removeAudioCallback(&audioPlayer);
     deviceManager.closeAudioDevice();
@@ -102,43 +150,157 @@ MainComponent::~MainComponent() {
 void MainComponent::paint(juce::Graphics& g) { g.fillAll(juce::Colours::darkgrey); }
 
 void MainComponent::resized() {
-    inputDeviceBox.setBounds(20, 20, getWidth() - 40, 30);
-    outputDeviceBox.setBounds(20, 60, getWidth() - 40, 30);
-    monoToggle.setBounds(20, 100, getWidth() - 40, 30);
-    gainSlider.setBounds(20, 140, getWidth() - 40, 30);
+    backendBox.setBounds(20, 20, getWidth() - 40, 30);
+    inputDeviceBox.setBounds(20, 60, getWidth() - 40, 30);
+    outputDeviceBox.setBounds(20, 100, getWidth() - 40, 30);
+
+    auto formatRow = juce::Rectangle<int>(20, 140, getWidth() - 40, 30);
+    sampleRateBox.setBounds(formatRow.removeFromLeft(120));
+    formatRow.removeFromLeft(10);
+    bufferSizeBox.setBounds(formatRow.removeFromLeft(120));
+    formatRow.removeFromLeft(10);
+    internalBlockBox.setBounds(formatRow.removeFromLeft(120));
+    formatRow.removeFromLeft(10);
+    measureLatencyButton.setBounds(formatRow.removeFromLeft(130));
+    formatRow.removeFromLeft(10);
+    latencyLabel.setBounds(formatRow);
+
+    traceButton.setBounds(getWidth() - 150, 180, 130, 30);
+    monoToggle.setBounds(20, 180, getWidth() - 180, 30);
+    gainSlider.setBounds(20, 220, getWidth() - 40, 30);
+    auto chainRow = juce::Rectangle<int>(20, 260, getWidth() - 40, 30);
+    goLiveButton.setBounds(chainRow.removeFromRight(100));
+    chainRow.removeFromRight(10);
+    crossfadeSlider.setBounds(chainRow.removeFromRight(200));
+    chainRow.removeFromRight(10);
+    chainBox.setBounds(chainRow.removeFromLeft(120));
+    chainRow.removeFromLeft(10);
+    chainLatencyLabel.setBounds(chainRow);
 
     if (pluginChainUI) {
         auto area = getLocalBounds();
-        area.setY(200);
-        area.setHeight(getHeight() - 200);
+        area.setY(300);
+        area.setHeight(getHeight() - 300);
         area.reduce(20, 20);
         pluginChainUI->setBounds(area);
     }
 }
 
 void MainComponent::comboBoxChanged(juce::ComboBox* box) {
+    if (box == &backendBox) selectBackend();
     if (box == &inputDeviceBox || box == &outputDeviceBox) updateAudioDevice();
+    if (box == &sampleRateBox || box == &bufferSizeBox) updateDeviceFormat();
+
+    if (box == &internalBlockBox && internalBlockBox.getSelectedId() > 0) {
+        pluginHost->setInternalBlockSize(internalBlockBox.getSelectedId() - 1);
+    }
+
+    if (box == &chainBox) {
+        pluginHost->setEditedChain(chainBox.getSelectedItemIndex());
+        pluginChainUI->editedChainChanged();
+        updateChainControls();
+    }
 }
 
 void MainComponent::buttonClicked(juce::Button* button) {
     if (button == &monoToggle) {
         pluginHost->setMonoInput(monoToggle.getToggleState());
+    } else if (button == &measureLatencyButton) {
+        measureLatency();
+    } else if (button == &traceButton) {
+        toggleTraceRecording();
+    } else if (button == &goLiveButton) {
+        pluginHost->setActiveChain(pluginHost->getEditedChain());
+        updateChainControls();
     }
 }
 
-void MainComponent::updateAudioDevice() {
-    auto config = deviceManager.getAudioDeviceSetup();
-    auto* type = deviceManager.getAvailableDeviceTypes()[0];
-    type->scanForDevices();
+void MainComponent::updateChainControls() {
+    const bool isLive = pluginHost->getEditedChain() == pluginHost->getActiveChain();
+    goLiveButton.setEnabled(!isLive);
+    goLiveButton.setButtonText(isLive ? "Live" : "Go live");
+
+    // every chain runs in its own graph, so this is all the latency going live would add
+    auto latency = pluginHost->getChainLatencySamples(pluginHost->getEditedChain());
+    auto text = "Chain latency: " + juce::String(latency) + " samples";
+    auto* device = deviceManager.getCurrentAudioDevice();
+    if (device != nullptr && device->getCurrentSampleRate() > 0.0) {
+        text << " (" << juce::String(1000.0 * latency / device->getCurrentSampleRate(), 1)
+             << " ms)";
+    }
+    chainLatencyLabel.setText(text, juce::dontSendNotification);
+}
 
+void MainComponent::changeListenerCallback(juce::ChangeBroadcaster* source) {
+    // the device manager broadcasts on every device change, including hot-plugging
+    if (source == &deviceManager) {
+        populateDeviceLists();
+        populateDeviceFormats();
+    } else if (source == pluginHost.get()) {
+        updateChainControls();
+    }
+}
+
+void MainComponent::populateDeviceLists() {
+    auto* type = deviceManager.getCurrentDeviceTypeObject();
+    if (type == nullptr) return;
+
+    auto config = deviceManager.getAudioDeviceSetup();
     auto inputDevices = type->getDeviceNames(true);
     auto outputDevices = type->getDeviceNames(false);
 
+    backendBox.setText(type->getTypeName(), juce::dontSendNotification);
+
+    inputDeviceBox.clear(juce::dontSendNotification);
+    outputDeviceBox.clear(juce::dontSendNotification);
+
+    for (int i = 0; i < inputDevices.size(); ++i) inputDeviceBox.addItem(inputDevices[i], i + 1);
+
+    for (int i = 0; i < outputDevices.size(); ++i) outputDeviceBox.addItem(outputDevices[i], i + 1);
+
+    inputDeviceBox.setSelectedItemIndex(
+        inputDevices.indexOf(config.inputDeviceName), juce::dontSendNotification);
+    outputDeviceBox.setSelectedItemIndex(
+        outputDevices.indexOf(config.outputDeviceName), juce::dontSendNotification);
+}
+
+void MainComponent::populateDeviceFormats() {
+    sampleRateBox.clear(juce::dontSendNotification);
+    bufferSizeBox.clear(juce::dontSendNotification);
+
+    auto* device = deviceManager.getCurrentAudioDevice();
+    if (device == nullptr) return;
+
+    for (auto rate : device->getAvailableSampleRates()) {
+        sampleRateBox.addItem(juce::String(rate, 0) + " Hz", juce::roundToInt(rate));
+    }
+
+    for (auto size : device->getAvailableBufferSizes()) {
+        bufferSizeBox.addItem(juce::String(size) + " samples", size);
+    }
+
+    sampleRateBox.setSelectedId(
+        juce::roundToInt(device->getCurrentSampleRate()), juce::dontSendNotification);
+    bufferSizeBox.setSelectedId(
+        device->getCurrentBufferSizeSamples(), juce::dontSendNotification);
+}
+
+void MainComponent::selectBackend() {
+    auto typeName = backendBox.getText();
+    if (typeName.isEmpty() || typeName == deviceManager.getCurrentAudioDeviceType()) return;
+
+    // opens the backend's default devices and broadcasts a change, which refills the lists
+    deviceManager.setCurrentAudioDeviceType(typeName, true);
+}
+
+void MainComponent::updateAudioDevice() {
+    auto config = deviceManager.getAudioDeviceSetup();
+
     const int inputIndex = inputDeviceBox.getSelectedItemIndex();
     const int outputIndex = outputDeviceBox.getSelectedItemIndex();
 
-    config.inputDeviceName = (inputIndex >= 0) ? inputDevices[inputIndex] : juce::String();
-    config.outputDeviceName = (outputIndex >= 0) ? outputDevices[outputIndex] : juce::String();
+    config.inputDeviceName = (inputIndex >= 0) ? inputDeviceBox.getText() : juce::String();
+    config.outputDeviceName = (outputIndex >= 0) ? outputDeviceBox.getText() : juce::String();
 
     config.useDefaultInputChannels = true;
     config.useDefaultOutputChannels = true;
@@ -150,3 +312,83 @@ void MainComponent::updateAudioDevice() {
             result);
     }
 }
+
+void MainComponent::updateDeviceFormat() {
+    auto config = deviceManager.getAudioDeviceSetup();
+
+    // item ids are the sample rate in Hz and the buffer size in samples
+    if (sampleRateBox.getSelectedId() > 0) config.sampleRate = sampleRateBox.getSelectedId();
+    if (bufferSizeBox.getSelectedId() > 0) config.bufferSize = bufferSizeBox.getSelectedId();
+
+    auto result = deviceManager.setAudioDeviceSetup(config, true);
+    if (result.isNotEmpty()) {
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
+            "Audio Device Error",
+            result);
+    }
+}
+
+void MainComponent::measureLatency() {
+    if (latencyMeasurer.isRunning() || deviceManager.getCurrentAudioDevice() == nullptr) return;
+
+    // the plugin chain would mix into the test signal, so its output is muted while measuring;
+    // suspending keeps every plugin prepared, detaching the player would re-prepare them all
+    measureLatencyButton.setEnabled(false);
+    latencyLabel.setText("Measuring, loop an output back to the input...",
+        juce::dontSendNotification);
+    pluginHost->getProcessor()->suspendProcessing(true);
+    deviceManager.addAudioCallback(&latencyMeasurer);
+
+    latencyMeasurer.start([this](const LatencyMeasurer::Result& result) {
+        deviceManager.removeAudioCallback(&latencyMeasurer);
+        pluginHost->getProcessor()->suspendProcessing(false);
+        measureLatencyButton.setEnabled(true);
+
+        if (result.aborted) {
+            latencyLabel.setText("Measurement interrupted, the device stopped delivering audio",
+                juce::dontSendNotification);
+            return;
+        }
+
+        if (!result.success) {
+            latencyLabel.setText("No loopback signal detected", juce::dontSendNotification);
+            return;
+        }
+
+        latencyLabel.setText("Round-trip latency: " + juce::String(result.latencySamples) +
+                                 " samples (" + juce::String(result.latencyMs, 2) +
+                                 " ms), driver reports " +
+                                 juce::String(result.reportedLatencySamples),
+            juce::dontSendNotification);
+    });
+}
+
+void MainComponent::toggleTraceRecording() {
+    auto& tracer = pluginHost->getTraceRecorder();
+
+    if (!tracer.isRecording()) {
+        auto traceDirectory = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                                  .getChildFile("MicAudioRack")
+                                  .getChildFile("traces");
+        traceDirectory.createDirectory();
+
+        auto traceFile = traceDirectory.getChildFile(
+            "trace-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".mart");
+        if (tracer.start(traceFile)) traceButton.setButtonText("Stop trace");
+        return;
+    }
+
+    tracer.stop();
+    traceButton.setButtonText("Record trace");
+
+    // the binary file is kept, the JSON next to it opens in chrome://tracing or Perfetto
+    auto traceFile = tracer.getFile();
+    auto jsonFile = traceFile.withFileExtension("json");
+    if (TraceRecorder::convertToChromeJson(traceFile, jsonFile)) {
+        std::cout << "Trace exported: " << jsonFile.getFullPathName() << std::endl;
+    } else {
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
+            "Trace Error",
+            "Cannot export trace " + traceFile.getFullPathName());
+    }
+}
@@ -2,13 +2,15 @@
 
 #include <juce_audio_utils/juce_audio_utils.h>
 
+#include "latency_measurer.h"
 #include "plugin_host.h"
 #include "ui/plugin_window.h"
 #include "ui/plugin_chain.h"
 
 class MainComponent : public juce::Component,
                       private juce::ComboBox::Listener,
-                      private juce::Button::Listener {
+                      private juce::Button::Listener,
+                      private juce::ChangeListener {
    public:
     MainComponent();
     ~MainComponent() override;
@@ -21,15 +23,40 @@ class MainComponent : public juce::Component,
     juce::AudioProcessorPlayer audioPlayer;
     std::unique_ptr<PluginHost> pluginHost;
     std::unique_ptr<PluginChainUI> pluginChainUI;
+    LatencyMeasurer latencyMeasurer;
 
+    juce::ComboBox backendBox;
     juce::ComboBox inputDeviceBox;
     juce::ComboBox outputDeviceBox;
+    juce::ComboBox sampleRateBox;
+    juce::ComboBox bufferSizeBox;
+    juce::ComboBox internalBlockBox;
+    juce::TextButton measureLatencyButton;
+    juce::Label latencyLabel;
     juce::ToggleButton monoToggle;
+    juce::TextButton traceButton;
     juce::Slider gainSlider;
+    juce::ComboBox chainBox;
+    juce::Label chainLatencyLabel;
+    juce::Slider crossfadeSlider;
+    juce::TextButton goLiveButton;
 
     void comboBoxChanged(juce::ComboBox* changedBox) override;
     void buttonClicked(juce::Button* button) override;
+    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+
+    /**
+     * Device names come from the list the device manager already scanned, changing a combo box
+     * never triggers a rescan
+     */
+    void populateDeviceLists();
+    void populateDeviceFormats();
+    void selectBackend();
     void updateAudioDevice();
+    void updateDeviceFormat();
+    void measureLatency();
+    void toggleTraceRecording();
+    void updateChainControls();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
\ No newline at end of file
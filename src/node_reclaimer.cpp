@@ -0,0 +1,82 @@
+#include "node_reclaimer.h"
+
+NodeReclaimer::NodeReclaimer() : juce::Thread("NodeReclaimer") { startThread(); }
+
+NodeReclaimer::~NodeReclaimer() {
+    // the worker never waits for the message thread, so stopping it can't deadlock
+    signalThreadShouldExit();
+    notify();
+    stopThread(pollIntervalMs * 10);
+    cancelPendingUpdate();
+
+    // the graph is gone by now, whatever is left is released and freed here
+    const juce::ScopedLock sl(lock);
+    release(pending);
+    pending.clear();
+    released.clear();
+}
+
+void NodeReclaimer::retire(juce::AudioProcessorGraph::Node::Ptr node) {
+    if (!node) return;
+
+    {
+        const juce::ScopedLock sl(lock);
+        pending.push_back(std::move(node));
+    }
+    notify();
+}
+
+void NodeReclaimer::run() {
+    while (!threadShouldExit()) {
+        std::vector<juce::AudioProcessorGraph::Node::Ptr> unreferenced;
+        bool idle = false;
+
+        {
+            const juce::ScopedLock sl(lock);
+
+            // nodes still referenced by a render sequence stay queued until it's freed
+            auto firstUnreferenced = std::stable_partition(pending.begin(),
+                pending.end(),
+                [](const juce::AudioProcessorGraph::Node::Ptr& node) {
+                    return node->getReferenceCount() > 1;
+                });
+
+            std::move(firstUnreferenced, pending.end(), std::back_inserter(unreferenced));
+            pending.erase(firstUnreferenced, pending.end());
+            idle = pending.empty();
+        }
+
+        if (!unreferenced.empty()) {
+            release(unreferenced);
+
+            {
+                const juce::ScopedLock sl(lock);
+                std::move(unreferenced.begin(), unreferenced.end(), std::back_inserter(released));
+            }
+            triggerAsyncUpdate();
+        }
+
+        wait(idle ? -1 : pollIntervalMs);
+    }
+}
+
+void NodeReclaimer::handleAsyncUpdate() {
+    std::vector<juce::AudioProcessorGraph::Node::Ptr> nodes;
+
+    {
+        const juce::ScopedLock sl(lock);
+        nodes.swap(released);
+    }
+
+    // dropping the last reference destroys the node together with its processor
+    nodes.clear();
+}
+
+void NodeReclaimer::release(std::vector<juce::AudioProcessorGraph::Node::Ptr>& nodes) {
+    for (auto& node : nodes) {
+        if (auto* processor = node->getProcessor()) {
+            std::cout << "NodeReclaimer: releasing " << processor->getName() << std::endl;
+            processor->releaseResources();
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+/**
+ * Takes nodes removed from the audio processor graph off the caller's hands. Once no render
+ * sequence refers to a node any more, its releaseResources() runs on a background thread, so
+ * freeing the plugin's processing state never blocks the message or audio thread.
+ * The processor itself is then destroyed on the message thread: VST3 instances move their
+ * teardown there anyway, and waiting for it from the background thread could deadlock on exit.
+ */
+class NodeReclaimer : private juce::Thread, private juce::AsyncUpdater {
+   public:
+    NodeReclaimer();
+    ~NodeReclaimer() override;
+
+    /**
+     * Queues a node that has already been removed from the graph. Render sequences hold their own
+     * references to the nodes they process, so the node is only released once the reclaimer holds
+     * the last reference, i.e. no render sequence the audio thread could still run refers to it.
+     */
+    void retire(juce::AudioProcessorGraph::Node::Ptr node);
+
+   private:
+    static constexpr int pollIntervalMs = 100;
+
+    juce::CriticalSection lock;
+    std::vector<juce::AudioProcessorGraph::Node::Ptr> pending;
+    std::vector<juce::AudioProcessorGraph::Node::Ptr> released;
+
+    void run() override;
+    void handleAsyncUpdate() override;
+    static void release(std::vector<juce::AudioProcessorGraph::Node::Ptr>& nodes);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NodeReclaimer)
+};
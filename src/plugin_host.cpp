@@ -1,16 +1,21 @@
 #include "plugin_host.h"
 
+#include "processors/chain_crossfade_processor.h"
 #include "processors/gain_processor.h"
+#include "processors/plugin_node_processor.h"
 
 PluginHost::PluginHost() {
     formatManager.addDefaultFormats();
     graph = std::make_unique<juce::AudioProcessorGraph>();
+    blockProcessor = std::make_unique<FixedBlockProcessor>(*graph, tracer);
     setupGraph();
     updateGraph();
 
     std::cout << "PluginHost: Constructor called" << std::endl;
 }
 
+PluginHost::~PluginHost() { masterReference.clear(); }
+
 void PluginHost::setupGraph() {
     graph->clear();
     graph->enableAllBuses();
@@ -21,6 +26,20 @@ void PluginHost::setupGraph() {
     outputNode = graph->addNode(std::make_unique<juce::AudioProcessorGraph::AudioGraphIOProcessor>(
         juce::AudioProcessorGraph::AudioGraphIOProcessor::audioOutputNode));
 
+    std::vector<juce::AudioProcessor*> slotGraphs;
+    for (auto& chain : chains) {
+        chain.graph = std::make_unique<juce::AudioProcessorGraph>();
+        chain.graph->enableAllBuses();
+        chain.inputNode =
+            chain.graph->addNode(std::make_unique<juce::AudioProcessorGraph::AudioGraphIOProcessor>(
+                juce::AudioProcessorGraph::AudioGraphIOProcessor::audioInputNode));
+        chain.outputNode =
+            chain.graph->addNode(std::make_unique<juce::AudioProcessorGraph::AudioGraphIOProcessor>(
+                juce::AudioProcessorGraph::AudioGraphIOProcessor::audioOutputNode));
+        slotGraphs.push_back(chain.graph.get());
+    }
+
+    crossfadeNode = graph->addNode(std::make_unique<ChainCrossfadeProcessor>(slotGraphs));
     masterGainNode = graph->addNode(std::make_unique<GainProcessor>());
 }
 
@@ -51,7 +70,16 @@ bool PluginHost::scanPlugins(const juce::File& directory) {
 
 bool PluginHost::addPlugin(const juce::PluginDescription& desc, int position) {
     juce::String error;
-    auto plugin = formatManager.createPluginInstance(desc, 44100.0, 512, error);
+    std::unique_ptr<juce::AudioPluginInstance> plugin;
+
+    {
+        const TraceRecorder::Scope scope(tracer,
+            tracer.registerName("Instantiate " + desc.descriptiveName),
+            TraceEventType::pluginInstantiate,
+            TraceSource::message);
+        plugin = formatManager.createPluginInstance(
+            desc, getPreparedSampleRate(), getPreparedBlockSize(), error);
+    }
 
     if (!plugin || error.isNotEmpty()) {
         DBG("Failed to instantiate plugin: " + error);
@@ -59,46 +87,113 @@ bool PluginHost::addPlugin(const juce::PluginDescription& desc, int position) {
         return false;
     }
 
-    plugin->enableAllBuses();
-    plugin->setPlayConfigDetails(2, 2, 44100.0, 512);
-
-    auto pluginNode = graph->addNode(std::move(plugin));
-    auto entry = std::make_unique<PluginEntry>();
-    entry->name = desc.descriptiveName;
-    entry->node = pluginNode;
-    entry->editor = nullptr;
-    entry->bypass = false;
-    entry->external = true;
-    connectPluginEntryToGraph(std::move(entry), position);
+    connectPluginEntryToGraph(
+        createPluginEntry(std::move(plugin), desc, editedChain), editedChain, position);
 
     return true;
 }
 
 bool PluginHost::addPlugin(std::unique_ptr<juce::AudioProcessor> processor, int position) {
     auto name = processor->getName();
-    auto pluginNode = graph->addNode(std::move(processor));
+    auto pluginNode = chains[editedChain].graph->addNode(
+        std::make_unique<PluginNodeProcessor>(std::move(processor), tracer));
 
     auto entry = std::make_unique<PluginEntry>();
     entry->name = name;
     entry->node = pluginNode;
     entry->bypass = false;
-    connectPluginEntryToGraph(std::move(entry), position);
+    connectPluginEntryToGraph(std::move(entry), editedChain, position);
 
     return true;
 }
 
+void PluginHost::addPluginAsync(const juce::PluginDescription& desc,
+    int chainIndex,
+    std::function<void(bool success)> onComplete) {
+    if (chainIndex < 0 || chainIndex >= numChainSlots) {
+        if (onComplete) onComplete(false);
+        return;
+    }
+
+    // async instantiation can't be a scope, so the span is assembled by hand
+    TraceRecorder::Event span{juce::Time::getHighResolutionTicks(),
+        0,
+        tracer.registerName("Instantiate " + desc.descriptiveName),
+        TraceEventType::pluginInstantiate,
+        TraceSource::message};
+
+    formatManager.createPluginInstanceAsync(desc,
+        getPreparedSampleRate(),
+        getPreparedBlockSize(),
+        [weakThis = juce::WeakReference<PluginHost>(this), desc, chainIndex, onComplete, span](
+            std::unique_ptr<juce::AudioPluginInstance> plugin, const juce::String& error) mutable {
+            // the host may be gone by the time the plugin finished loading
+            auto* host = weakThis.get();
+            if (host == nullptr) return;
+
+            span.endTicks = juce::Time::getHighResolutionTicks();
+            host->tracer.addEvent(span);
+
+            if (!plugin || error.isNotEmpty()) {
+                DBG("Failed to instantiate plugin: " + error);
+                std::cerr << "Failed to instantiate plugin: " << error << std::endl;
+                if (onComplete) onComplete(false);
+                return;
+            }
+
+            host->connectPluginEntryToGraph(
+                host->createPluginEntry(std::move(plugin), desc, chainIndex), chainIndex, -1);
+            if (onComplete) onComplete(true);
+        });
+}
+
+std::unique_ptr<PluginEntry> PluginHost::createPluginEntry(
+    std::unique_ptr<juce::AudioPluginInstance> plugin,
+    const juce::PluginDescription& desc,
+    int chainIndex) {
+    plugin->enableAllBuses();
+    plugin->setPlayConfigDetails(2, 2, getPreparedSampleRate(), getPreparedBlockSize());
+
+    auto entry = std::make_unique<PluginEntry>();
+    entry->name = desc.descriptiveName;
+    entry->node = chains[chainIndex].graph->addNode(
+        std::make_unique<PluginNodeProcessor>(std::move(plugin), tracer));
+    entry->editor = nullptr;
+    entry->bypass = false;
+    entry->external = true;
+
+    return entry;
+}
+
 bool PluginHost::removePlugin(int index) {
+    auto& chain = chains[editedChain];
+    auto& pluginEntries = chain.entries;
     if (index < 0 || index >= pluginEntries.size()) {
         return false;
     }
 
+    auto entry = std::move(pluginEntries[index]);
     pluginEntries.erase(pluginEntries.begin() + index);
-    updateGraph();
+
+    // the editor references the processor, so it must go first (and on the message thread)
+    entry->editor = nullptr;
+
+    if (entry->node) {
+        // a synchronous rebuild hands the audio thread a render sequence without this node, the
+        // reclaimer then waits for the old sequence (and its reference) to be freed
+        chain.graph->removeNode(entry->node->nodeID, juce::AudioProcessorGraph::UpdateKind::sync);
+        reclaimer.retire(std::move(entry->node));
+    }
+
+    connectChainToGraph(chain);
+    std::cout << "Plugin removed from audio processor graph: " << entry->name << std::endl;
 
     return true;
 }
 
 bool PluginHost::movePlugin(int fromIndex, int toIndex) {
+    auto& chain = chains[editedChain];
+    auto& pluginEntries = chain.entries;
     if (fromIndex < 0 || fromIndex >= pluginEntries.size() || toIndex < 0 ||
         toIndex >= pluginEntries.size())
         return false;
@@ -106,23 +201,52 @@ bool PluginHost::movePlugin(int fromIndex, int toIndex) {
     auto entry = std::move(pluginEntries[fromIndex]);
     pluginEntries.erase(pluginEntries.begin() + fromIndex);
     pluginEntries.insert(pluginEntries.begin() + toIndex, std::move(entry));
-    updateGraph();
+    connectChainToGraph(chain);
 
     return true;
 }
 
 bool PluginHost::bypassPlugin(int index, bool bypass) {
+    auto& chain = chains[editedChain];
+    auto& pluginEntries = chain.entries;
     if (index < 0 || index >= pluginEntries.size()) {
         return false;
     }
 
     pluginEntries.at(index)->bypass = bypass;
-    updateGraph();
+    connectChainToGraph(chain);
 
     return true;
 }
 
-void PluginHost::connectPluginEntryToGraph(std::unique_ptr<PluginEntry> entry, int position) {
+bool PluginHost::setPluginOversampling(int index, int factor, bool linearPhase) {
+    auto& chain = chains[editedChain];
+    auto& pluginEntries = chain.entries;
+    if (index < 0 || index >= pluginEntries.size()) {
+        return false;
+    }
+
+    auto& entry = pluginEntries.at(index);
+    if (!entry->node) return false;
+
+    auto nodeProcessor = dynamic_cast<PluginNodeProcessor*>(entry->node->getProcessor());
+    if (!nodeProcessor) return false;
+
+    nodeProcessor->setOversampling(factor, linearPhase);
+    entry->oversamplingFactor = nodeProcessor->getOversamplingFactor();
+    entry->oversamplingLinearPhase = linearPhase;
+
+    // rebuilding the connections makes the graph pick up the node's new latency
+    connectChainToGraph(chain);
+
+    return true;
+}
+
+void PluginHost::connectPluginEntryToGraph(std::unique_ptr<PluginEntry> entry,
+    int chainIndex,
+    int position) {
+    auto& chain = chains[chainIndex];
+    auto& pluginEntries = chain.entries;
     auto entryName = entry->name;
 
     if (position < 0 || position >= pluginEntries.size()) {
@@ -131,7 +255,7 @@ void PluginHost::connectPluginEntryToGraph(std::unique_ptr<PluginEntry> entry, i
         pluginEntries.insert(pluginEntries.begin() + position, std::move(entry));
     }
 
-    updateGraph();
+    connectChainToGraph(chain);
     std::cout << "Plugin connected to audio processor graph: " << entryName << std::endl;
 }
 
@@ -144,6 +268,51 @@ void PluginHost::setMonoInput(bool enabled) {
 
 bool PluginHost::isMonoInput() const { return monoInput; }
 
+void PluginHost::setEditedChain(int chainIndex) {
+    editedChain = juce::jlimit(0, numChainSlots - 1, chainIndex);
+}
+
+void PluginHost::setActiveChain(int chainIndex) {
+    activeChain = juce::jlimit(0, numChainSlots - 1, chainIndex);
+    if (auto crossfade = dynamic_cast<ChainCrossfadeProcessor*>(crossfadeNode->getProcessor())) {
+        crossfade->setActiveSlot(activeChain);
+    }
+    updateActiveChainLatency();
+    sendChangeMessage();
+}
+
+void PluginHost::updateActiveChainLatency() {
+    if (auto crossfade = dynamic_cast<ChainCrossfadeProcessor*>(crossfadeNode->getProcessor())) {
+        crossfade->updateLatency();
+
+        // the top level graph reads its nodes' latency when it rebuilds
+        graph->rebuild();
+    }
+}
+
+int PluginHost::getChainLatencySamples(int chainIndex) const {
+    if (chainIndex < 0 || chainIndex >= numChainSlots) return 0;
+    return chains[chainIndex].graph->getLatencySamples();
+}
+
+void PluginHost::setChainCrossfadeMilliseconds(float milliseconds) {
+    if (auto crossfade = dynamic_cast<ChainCrossfadeProcessor*>(crossfadeNode->getProcessor())) {
+        crossfade->setCrossfadeMilliseconds(milliseconds);
+    }
+}
+
+void PluginHost::setInternalBlockSize(int samples) { blockProcessor->setFixedBlockSize(samples); }
+
+int PluginHost::getInternalBlockSize() const { return blockProcessor->getFixedBlockSize(); }
+
+double PluginHost::getPreparedSampleRate() const {
+    return graph->getSampleRate() > 0.0 ? graph->getSampleRate() : 44100.0;
+}
+
+int PluginHost::getPreparedBlockSize() const {
+    return graph->getBlockSize() > 0 ? graph->getBlockSize() : 512;
+}
+
 void PluginHost::setMasterGainDecibels(float decibels) {
     if (auto gainProcessor = dynamic_cast<GainProcessor*>(masterGainNode->getProcessor())) {
         gainProcessor->setGainDecibels(decibels);
@@ -152,42 +321,78 @@ void PluginHost::setMasterGainDecibels(float decibels) {
 
 void PluginHost::updateGraph() {
     std::cout << "Updating plugin graph. Mono: " << (monoInput ? "true" : "false") << std::endl;
-    std::cout << "Plugins count in bus: " << pluginEntries.size() << std::endl;
 
     auto prevConnections = graph->getConnections();
     for (auto& conn : prevConnections) {
         graph->removeConnection(conn);
     }
 
-    auto lastNodeId = inputNode->nodeID;
-    for (auto& entry : pluginEntries) {
+    // the top level graph is a single path, the chains (and their latency) live in the slots
+    graph->addConnection({{inputNode->nodeID, 0}, {crossfadeNode->nodeID, 0}});
+    graph->addConnection({{inputNode->nodeID, 1}, {crossfadeNode->nodeID, 1}});
+
+    graph->addConnection({{crossfadeNode->nodeID, 0}, {masterGainNode->nodeID, 0}});
+    graph->addConnection({{crossfadeNode->nodeID, 1}, {masterGainNode->nodeID, 1}});
+
+    graph->addConnection({{masterGainNode->nodeID, 0}, {outputNode->nodeID, 0}});
+    graph->addConnection({{masterGainNode->nodeID, 1}, {outputNode->nodeID, 1}});
+
+    for (auto& chain : chains) {
+        connectChainToGraph(chain);
+    }
+}
+
+void PluginHost::connectChainToGraph(ChainSlot& chain) {
+    const TraceRecorder::Scope scope(tracer,
+        tracer.getGraphUpdateNameId(),
+        TraceEventType::graphUpdate,
+        TraceSource::message);
+
+    std::cout << "Updating chain graph. Plugins count: " << chain.entries.size() << std::endl;
+
+    auto& chainGraph = *chain.graph;
+    auto inputNodeId = chain.inputNode->nodeID;
+    auto outputNodeId = chain.outputNode->nodeID;
+
+    auto prevConnections = chainGraph.getConnections();
+    for (auto& conn : prevConnections) {
+        chainGraph.removeConnection(conn);
+    }
+
+    auto lastNodeId = inputNodeId;
+    for (auto& entry : chain.entries) {
         if (!entry->node || entry->bypass) continue;
-        if (lastNodeId == inputNode->nodeID && monoInput) {
-            graph->addConnection({{inputNode->nodeID, 0}, {entry->node->nodeID, 0}});
-            graph->addConnection({{inputNode->nodeID, 0}, {entry->node->nodeID, 1}});
+        if (lastNodeId == inputNodeId && monoInput) {
+            chainGraph.addConnection({{inputNodeId, 0}, {entry->node->nodeID, 0}});
+            chainGraph.addConnection({{inputNodeId, 0}, {entry->node->nodeID, 1}});
         } else {
-            graph->addConnection({{lastNodeId, 0}, {entry->node->nodeID, 0}});
-            graph->addConnection({{lastNodeId, 1}, {entry->node->nodeID, 1}});
+            chainGraph.addConnection({{lastNodeId, 0}, {entry->node->nodeID, 0}});
+            chainGraph.addConnection({{lastNodeId, 1}, {entry->node->nodeID, 1}});
         }
         lastNodeId = entry->node->nodeID;
     }
 
     // in case when all plugins are in bypass (or plugins list is empty)
-    if (lastNodeId == inputNode->nodeID) {
-        graph->addConnection({{inputNode->nodeID, 0}, {masterGainNode->nodeID, 0}});
-        graph->addConnection({{inputNode->nodeID, monoInput ? 0 : 1}, {masterGainNode->nodeID, 1}});
+    if (lastNodeId == inputNodeId) {
+        chainGraph.addConnection({{inputNodeId, 0}, {outputNodeId, 0}});
+        chainGraph.addConnection({{inputNodeId, monoInput ? 0 : 1}, {outputNodeId, 1}});
     } else {
-        graph->addConnection({{lastNodeId, 0}, {masterGainNode->nodeID, 0}});
-        graph->addConnection({{lastNodeId, 1}, {masterGainNode->nodeID, 1}});
+        chainGraph.addConnection({{lastNodeId, 0}, {outputNodeId, 0}});
+        chainGraph.addConnection({{lastNodeId, 1}, {outputNodeId, 1}});
     }
 
-    graph->addConnection({{masterGainNode->nodeID, 0}, {outputNode->nodeID, 0}});
-    graph->addConnection({{masterGainNode->nodeID, 1}, {outputNode->nodeID, 1}});
-
-    for (auto& connection : graph->getConnections()) {
+    for (auto& connection : chainGraph.getConnections()) {
         std::cout << "Connection: " << connection.source.nodeID.uid << " -> "
                   << connection.destination.nodeID.uid << std::endl;
     }
+
+    // connection changes only schedule an async rebuild, the chain's latency is computed by the
+    // rebuild, so it has to run before the latency is read
+    chainGraph.rebuild();
+    updateActiveChainLatency();
+    sendChangeMessage();
 }
 
-juce::AudioProcessorGraph* PluginHost::getGraph() { return graph.get(); }
\ No newline at end of file
+juce::AudioProcessorGraph* PluginHost::getGraph() { return graph.get(); }
+
+juce::AudioProcessor* PluginHost::getProcessor() { return blockProcessor.get(); }
\ No newline at end of file
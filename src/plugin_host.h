@@ -2,19 +2,44 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 
+#include <array>
+
+#include "node_reclaimer.h"
+#include "processors/fixed_block_processor.h"
+#include "trace_recorder.h"
+
 struct PluginEntry {
     juce::String name;
     juce::AudioProcessorGraph::Node::Ptr node;
     std::unique_ptr<juce::AudioProcessorEditor> editor;
     bool bypass = false;
     bool external = false;
+    int oversamplingFactor = 1;
+    bool oversamplingLinearPhase = false;
 };
 
-class PluginHost {
+/**
+ * Owns the plugin chains and the graphs they run in. Broadcasts a change whenever a chain is
+ * rewired or the active chain changes, so latency displays can follow.
+ */
+class PluginHost : public juce::ChangeBroadcaster {
    public:
+    /**
+     * Number of alternate chains kept warm. Each one runs in its own graph, so a latent plugin
+     * in an idle chain doesn't delay the live one. All of them are always running, only the
+     * active one is audible.
+     */
+    static constexpr int numChainSlots = 4;
+
     PluginHost();
+    ~PluginHost();
 
     juce::AudioProcessorGraph* getGraph();
+
+    /**
+     * Top level processor to hand to the audio player: the graph behind the block size adapter
+     */
+    juce::AudioProcessor* getProcessor();
     bool scanPlugins(const juce::File& pluginFile);
     void updateGraph();
     void setMonoInput(bool enabled);
@@ -22,28 +47,104 @@ class PluginHost {
     bool isMonoInput() const;
 
     /**
-     * Adds and initializes specified plugin to the audio processor graph
+     * Processes the chain in fixed blocks of the given size (0 disables it), adding that many
+     * samples of latency. Smaller than the device buffer splits callbacks, larger coalesces them.
+     */
+    void setInternalBlockSize(int samples);
+    int getInternalBlockSize() const;
+
+    /**
+     * Selects the chain that add/remove/move/bypass operate on and getPluginEntries returns.
+     * Editing a chain doesn't make it audible.
+     */
+    void setEditedChain(int chainIndex);
+    int getEditedChain() const { return editedChain; }
+
+    /**
+     * Crossfades the output to the given chain. Its plugins are already instantiated and
+     * prepared, so the switch doesn't touch the graph.
+     */
+    void setActiveChain(int chainIndex);
+    int getActiveChain() const { return activeChain; }
+    void setChainCrossfadeMilliseconds(float milliseconds);
+
+    /**
+     * Latency of the given chain alone, i.e. what the output is delayed by while it's live
+     */
+    int getChainLatencySamples(int chainIndex) const;
+
+    /**
+     * Adds and initializes specified plugin to the edited chain of the audio processor graph
      */
     bool addPlugin(const juce::PluginDescription& desc, int position = -1);
     bool addPlugin(std::unique_ptr<juce::AudioProcessor> processor, int position = -1);
+
+    /**
+     * Instantiates the plugin without blocking the caller and appends it to the given chain.
+     * The callback is invoked on the message thread once the plugin is in the graph.
+     */
+    void addPluginAsync(const juce::PluginDescription& desc,
+        int chainIndex,
+        std::function<void(bool success)> onComplete = nullptr);
+
+    /**
+     * Detaches the plugin from the graph and hands it to the reclaimer, which releases it in the
+     * background and destroys it on the message thread
+     */
     bool removePlugin(int index);
     bool movePlugin(int fromIndex, int toIndex);
     bool bypassPlugin(int index, bool bypass);
 
+    /**
+     * Runs the plugin at 1x, 2x, 4x or 8x the device rate with minimum or linear phase
+     * half-band filters. The filter latency is compensated by the graph.
+     */
+    bool setPluginOversampling(int index, int factor, bool linearPhase);
+
+    TraceRecorder& getTraceRecorder() { return tracer; }
     juce::KnownPluginList& getLoadedPluginList() { return loadedPluginList; }
-    std::vector<std::unique_ptr<PluginEntry>>& getPluginEntries() { return pluginEntries; }
+    std::vector<std::unique_ptr<PluginEntry>>& getPluginEntries() {
+        return chains[editedChain].entries;
+    }
 
    private:
+    struct ChainSlot {
+        std::unique_ptr<juce::AudioProcessorGraph> graph;
+        juce::AudioProcessorGraph::Node::Ptr inputNode;
+        juce::AudioProcessorGraph::Node::Ptr outputNode;
+        std::vector<std::unique_ptr<PluginEntry>> entries;
+    };
+
+    TraceRecorder tracer;
+    NodeReclaimer reclaimer;
     juce::KnownPluginList loadedPluginList;
     juce::AudioPluginFormatManager formatManager;
+    // the slot graphs are hosted inside the top level graph's crossfade node, so they outlive it
+    std::array<ChainSlot, numChainSlots> chains;
     std::unique_ptr<juce::AudioProcessorGraph> graph;
-    std::vector<std::unique_ptr<PluginEntry>> pluginEntries;
+    std::unique_ptr<FixedBlockProcessor> blockProcessor;
 
     juce::AudioProcessorGraph::Node::Ptr inputNode;
     juce::AudioProcessorGraph::Node::Ptr outputNode;
+    juce::AudioProcessorGraph::Node::Ptr crossfadeNode;
     juce::AudioProcessorGraph::Node::Ptr masterGainNode;
 
     bool monoInput = false;
+    int editedChain = 0;
+    int activeChain = 0;
+
     void setupGraph();
-    void connectPluginEntryToGraph(std::unique_ptr<PluginEntry> entry, int position);
-};
\ No newline at end of file
+    void connectChainToGraph(ChainSlot& chain);
+    void connectPluginEntryToGraph(std::unique_ptr<PluginEntry> entry,
+        int chainIndex,
+        int position);
+    std::unique_ptr<PluginEntry> createPluginEntry(
+        std::unique_ptr<juce::AudioPluginInstance> plugin,
+        const juce::PluginDescription& desc,
+        int chainIndex);
+    void updateActiveChainLatency();
+    double getPreparedSampleRate() const;
+    int getPreparedBlockSize() const;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PluginHost)
+};
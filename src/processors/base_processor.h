@@ -9,6 +9,8 @@ class ProcessorBase : public juce::AudioProcessor {
                              .withOutput("Output", juce::AudioChannelSet::stereo())) {
     }
 
+    explicit ProcessorBase(const BusesProperties& buses) : AudioProcessor(buses) {}
+
     void prepareToPlay(double, int) override {}
     void releaseResources() override {}
     void processBlock(juce::AudioSampleBuffer&, juce::MidiBuffer&) override {}
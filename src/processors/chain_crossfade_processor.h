@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+
+#include "base_processor.h"
+
+/**
+ * Runs several chain slots side by side and outputs one of them. Each slot is a processor of its
+ * own (a graph per chain), so latency in one chain never delays the others the way converging
+ * inputs of a single graph node would. Switching slots runs a linear crossfade that starts at
+ * the beginning of the next block, every chain keeps running and nothing is re-prepared.
+ * Switching again mid-fade continues from the current mix: the new slot ramps up from whatever
+ * gain it has, and the slots fading out keep their ratio while making room for it.
+ */
+class ChainCrossfadeProcessor : public ProcessorBase {
+   public:
+    explicit ChainCrossfadeProcessor(std::vector<juce::AudioProcessor*> chainSlots)
+        : slots(std::move(chainSlots)), slotBuffers(slots.size()), slotGains(slots.size()) {}
+
+    void setActiveSlot(int slot) {
+        targetSlot.store(juce::jlimit(0, static_cast<int>(slots.size()) - 1, slot));
+        updateLatency();
+    }
+
+    void setCrossfadeMilliseconds(float milliseconds) { crossfadeMs.store(milliseconds); }
+
+    /**
+     * Reports the active chain's latency as the latency of this processor. Message thread only.
+     */
+    void updateLatency() { setLatencySamples(slots[targetSlot.load()]->getLatencySamples()); }
+
+    void prepareToPlay(double newSampleRate, int samplesPerBlock) override {
+        sampleRate = newSampleRate;
+
+        for (size_t i = 0; i < slots.size(); ++i) {
+            slots[i]->setPlayConfigDetails(2, 2, newSampleRate, samplesPerBlock);
+            slots[i]->prepareToPlay(newSampleRate, samplesPerBlock);
+            slotBuffers[i].setSize(2, samplesPerBlock);
+        }
+
+        reset();
+        updateLatency();
+    }
+
+    void releaseResources() override {
+        for (auto* slot : slots) slot->releaseResources();
+    }
+
+    void reset() override {
+        for (auto* slot : slots) slot->reset();
+
+        const auto target = static_cast<size_t>(targetSlot.load());
+        for (size_t i = 0; i < slotGains.size(); ++i) {
+            slotGains[i] = i == target ? 1.0f : 0.0f;
+        }
+    }
+
+    void processBlock(juce::AudioSampleBuffer& buffer, juce::MidiBuffer&) override {
+        const int numSamples = buffer.getNumSamples();
+        const int numChannels = juce::jmin(buffer.getNumChannels(), 2);
+
+        // every slot gets its own copy of the input, idle ones included, to stay warm
+        for (size_t i = 0; i < slots.size(); ++i) {
+            auto& slotBuffer = slotBuffers[i];
+            slotBuffer.setSize(2, numSamples, false, false, true);
+            slotBuffer.clear();
+            for (int channel = 0; channel < numChannels; ++channel) {
+                slotBuffer.copyFrom(channel, 0, buffer, channel, 0, numSamples);
+            }
+
+            slotMidi.clear();
+            slots[i]->processBlock(slotBuffer, slotMidi);
+        }
+
+        const auto target = static_cast<size_t>(targetSlot.load());
+
+        if (slotGains[target] >= 1.0f) {
+            for (int channel = 0; channel < numChannels; ++channel) {
+                buffer.copyFrom(channel, 0, slotBuffers[target], channel, 0, numSamples);
+            }
+            return;
+        }
+
+        const float step = 1.0f
+                           / static_cast<float>(juce::jmax(
+                               1, juce::roundToInt(sampleRate * crossfadeMs.load() / 1000.0)));
+
+        for (int i = 0; i < numSamples; ++i) {
+            // the target ramps up linearly, the others are scaled down so the gains sum to one
+            const float previousGain = slotGains[target];
+            const float gain = juce::jmin(1.0f, previousGain + step);
+            const float othersScale =
+                previousGain < 1.0f ? (1.0f - gain) / (1.0f - previousGain) : 0.0f;
+
+            for (size_t slot = 0; slot < slotGains.size(); ++slot) {
+                slotGains[slot] = slot == target ? gain : slotGains[slot] * othersScale;
+            }
+
+            for (int channel = 0; channel < numChannels; ++channel) {
+                float sample = 0.0f;
+                for (size_t slot = 0; slot < slotGains.size(); ++slot) {
+                    if (slotGains[slot] > 0.0f) {
+                        sample += slotBuffers[slot].getSample(channel, i) * slotGains[slot];
+                    }
+                }
+                buffer.setSample(channel, i, sample);
+            }
+        }
+    }
+
+    const juce::String getName() const override { return "Chain Crossfade"; }
+
+   private:
+    const std::vector<juce::AudioProcessor*> slots;
+    std::vector<juce::AudioBuffer<float>> slotBuffers;
+    std::vector<float> slotGains;
+    juce::MidiBuffer slotMidi;
+
+    std::atomic<int> targetSlot{0};
+    std::atomic<float> crossfadeMs{20.0f};
+
+    double sampleRate = 44100.0;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "../trace_recorder.h"
+#include "base_processor.h"
+
+/**
+ * Runs the wrapped processor in blocks of a fixed size, whatever the device callback delivers.
+ * Larger callbacks are split into several blocks and small or irregular callbacks are coalesced,
+ * so the hosted plugins always see the same block size. The price is one block of latency,
+ * for audio and MIDI alike. A block size of 0 passes callbacks straight through. Every callback
+ * is traced as one span. Covered by the "FixedBlockProcessor" unit test.
+ *
+ * The wrapped processor is prepared for the larger of the device block and maxFixedBlockSize,
+ * so switching the block size never has to re-prepare the plugins.
+ */
+class FixedBlockProcessor : public ProcessorBase, private juce::AudioProcessorListener {
+   public:
+    static constexpr int maxFixedBlockSize = 1024;
+
+    FixedBlockProcessor(juce::AudioProcessor& processorToWrap, TraceRecorder& traceRecorder)
+        : inner(processorToWrap), tracer(traceRecorder) {
+        inner.addListener(this);
+    }
+
+    ~FixedBlockProcessor() override { inner.removeListener(this); }
+
+    /**
+     * Changes the internal block size. The new blocks are allocated first and swapped in under
+     * the callback lock, so the audio callback is only held off for the swap.
+     */
+    void setFixedBlockSize(int samples) {
+        FifoBlocks replacement;
+        const int newSize = juce::jlimit(0, maxFixedBlockSize, samples);
+        allocateBlocks(replacement, newSize);
+
+        {
+            const juce::ScopedLock sl(getCallbackLock());
+            fixedBlockSize = newSize;
+            std::swap(fifo, replacement);
+        }
+
+        updateLatency();
+    }
+
+    int getFixedBlockSize() const { return fixedBlockSize; }
+
+    void prepareToPlay(double sampleRate, int samplesPerBlock) override {
+        deviceSampleRate = sampleRate;
+        deviceBlockSize = samplesPerBlock;
+        prepareInner();
+    }
+
+    void releaseResources() override { inner.releaseResources(); }
+
+    void reset() override {
+        inner.reset();
+        clearBlocks(fifo);
+    }
+
+    void processBlock(juce::AudioSampleBuffer& buffer, juce::MidiBuffer& midi) override {
+        const TraceRecorder::Scope scope(tracer,
+            tracer.getAudioCallbackNameId(),
+            TraceEventType::audioCallback,
+            TraceSource::audio);
+
+        if (fixedBlockSize == 0) {
+            inner.processBlock(buffer, midi);
+            return;
+        }
+
+        auto& blocks = fifo.blocks;
+        auto& blockMidi = fifo.midi;
+        const int numChannels = juce::jmin(buffer.getNumChannels(), blocks[0].getNumChannels());
+        const int numSamples = buffer.getNumSamples();
+        int position = 0;
+        outputMidi.clear();
+
+        // input and output advance in lockstep: the sample written into the pending block is
+        // replaced by the one at the same offset of the previously processed block, and MIDI
+        // events are shifted by the same amount
+        while (position < numSamples) {
+            const int count =
+                juce::jmin(numSamples - position, fixedBlockSize - fifo.blockPosition);
+            const int pending = fifo.pendingBlock;
+            const int processed = 1 - pending;
+
+            for (int channel = 0; channel < numChannels; ++channel) {
+                blocks[pending].copyFrom(
+                    channel, fifo.blockPosition, buffer, channel, position, count);
+                buffer.copyFrom(
+                    channel, position, blocks[processed], channel, fifo.blockPosition, count);
+            }
+
+            blockMidi[pending].addEvents(midi, position, count, fifo.blockPosition - position);
+            outputMidi.addEvents(
+                blockMidi[processed], fifo.blockPosition, count, position - fifo.blockPosition);
+
+            position += count;
+            fifo.blockPosition += count;
+
+            if (fifo.blockPosition == fixedBlockSize) {
+                // the processed slot becomes the next pending one, its events are all sent
+                inner.processBlock(blocks[pending], blockMidi[pending]);
+                blockMidi[processed].clear();
+                fifo.pendingBlock = processed;
+                fifo.blockPosition = 0;
+            }
+        }
+
+        midi.swapWith(outputMidi);
+    }
+
+    const juce::String getName() const override { return "Fixed Block"; }
+
+   private:
+    juce::AudioProcessor& inner;
+    TraceRecorder& tracer;
+    int fixedBlockSize = 0;
+
+    double deviceSampleRate = 44100.0;
+    int deviceBlockSize = 512;
+
+    /** Everything that depends on the block size, so a resize can be swapped in as a whole. */
+    struct FifoBlocks {
+        juce::AudioBuffer<float> blocks[2];
+        juce::MidiBuffer midi[2];
+        int pendingBlock = 0;
+        int blockPosition = 0;
+    };
+
+    FifoBlocks fifo;
+    juce::MidiBuffer outputMidi;
+
+    void prepareInner() {
+        const int innerBlockSize = juce::jmax(deviceBlockSize, maxFixedBlockSize);
+
+        allocateBlocks(fifo, fixedBlockSize);
+        outputMidi.ensureSize(2048);
+
+        inner.setPlayConfigDetails(getTotalNumInputChannels(),
+            getTotalNumOutputChannels(),
+            deviceSampleRate,
+            innerBlockSize);
+        inner.prepareToPlay(deviceSampleRate, innerBlockSize);
+        updateLatency();
+    }
+
+    void allocateBlocks(FifoBlocks& target, int blockSize) const {
+        const int numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+        for (auto& block : target.blocks) {
+            block.setSize(numChannels, juce::jmax(1, blockSize));
+        }
+        for (auto& buffer : target.midi) {
+            buffer.ensureSize(2048);
+        }
+        clearBlocks(target);
+    }
+
+    static void clearBlocks(FifoBlocks& target) {
+        for (auto& block : target.blocks) block.clear();
+        for (auto& buffer : target.midi) buffer.clear();
+        target.pendingBlock = 0;
+        target.blockPosition = 0;
+    }
+
+    void updateLatency() { setLatencySamples(fixedBlockSize + inner.getLatencySamples()); }
+
+    void audioProcessorParameterChanged(juce::AudioProcessor*, int, float) override {}
+
+    void audioProcessorChanged(juce::AudioProcessor*, const ChangeDetails& details) override {
+        if (details.latencyChanged) updateLatency();
+    }
+};
@@ -0,0 +1,91 @@
+#include "fixed_block_processor.h"
+
+class FixedBlockProcessorTests : public juce::UnitTest {
+   public:
+    FixedBlockProcessorTests() : juce::UnitTest("FixedBlockProcessor") {}
+
+    void runTest() override {
+        for (int blockSize : {16, 64, 100, 256}) {
+            beginTest("Delays audio and MIDI by exactly one block of " + juce::String(blockSize));
+            runFifo(blockSize);
+        }
+    }
+
+   private:
+    static constexpr int totalSamples = 8192;
+    static constexpr int maxCallbackSize = 512;
+    static constexpr int midiInterval = 37;
+
+    void runFifo(int blockSize) {
+        TraceRecorder tracer;
+        ProcessorBase passthrough;
+        FixedBlockProcessor processor(passthrough, tracer);
+
+        processor.setPlayConfigDetails(2, 2, 48000.0, maxCallbackSize);
+        processor.prepareToPlay(48000.0, maxCallbackSize);
+        processor.setFixedBlockSize(blockSize);
+        expectEquals(processor.getLatencySamples(), blockSize);
+
+        // irregular callback sizes, both smaller and larger than the fixed block
+        const int callbackSizes[] = {1, 7, 64, 129, 13, 500, 31, 256, 3, 97};
+
+        juce::AudioBuffer<float> buffer(2, maxCallbackSize);
+        juce::MidiBuffer midi;
+        std::vector<int> inputEvents, outputEvents;
+        int mismatches = 0;
+        int position = 0;
+
+        for (int callback = 0; position < totalSamples; ++callback) {
+            const int numSamples = juce::jmin(
+                callbackSizes[callback % juce::numElementsInArray(callbackSizes)],
+                totalSamples - position);
+            buffer.setSize(2, numSamples, false, false, true);
+            midi.clear();
+
+            // each sample carries its own position, so any misplaced one shows up
+            for (int i = 0; i < numSamples; ++i) {
+                const auto value = static_cast<float>(position + i + 1);
+                buffer.setSample(0, i, value);
+                buffer.setSample(1, i, -value);
+
+                if ((position + i) % midiInterval == 0) {
+                    midi.addEvent(juce::MidiMessage::noteOn(1, 60, 1.0f), i);
+                    inputEvents.push_back(position + i);
+                }
+            }
+
+            processor.processBlock(buffer, midi);
+
+            for (int i = 0; i < numSamples; ++i) {
+                const int source = position + i - blockSize;
+                const auto expected = source >= 0 ? static_cast<float>(source + 1) : 0.0f;
+                if (buffer.getSample(0, i) != expected || buffer.getSample(1, i) != -expected) {
+                    ++mismatches;
+                }
+            }
+
+            for (const auto metadata : midi) {
+                outputEvents.push_back(position + metadata.samplePosition);
+            }
+
+            position += numSamples;
+        }
+
+        expectEquals(mismatches, 0);
+
+        // events of the last block are still waiting in the FIFO
+        inputEvents.erase(std::remove_if(inputEvents.begin(),
+                              inputEvents.end(),
+                              [blockSize](int event) {
+                                  return event >= totalSamples - blockSize;
+                              }),
+            inputEvents.end());
+
+        expectEquals(static_cast<int>(outputEvents.size()), static_cast<int>(inputEvents.size()));
+        for (size_t i = 0; i < juce::jmin(inputEvents.size(), outputEvents.size()); ++i) {
+            expectEquals(outputEvents[i], inputEvents[i] + blockSize);
+        }
+    }
+};
+
+static FixedBlockProcessorTests fixedBlockProcessorTests;
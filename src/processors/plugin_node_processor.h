@@ -0,0 +1,373 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include "../trace_recorder.h"
+
+/**
+ * Node processor every plugin in the chain is hosted in. It records each processBlock call as a
+ * trace span and otherwise behaves like the wrapped plugin: it is an AudioPluginInstance with the
+ * plugin's description, bus layout, parameters (including bypass) and processing precision, and
+ * it forwards the play head and realtime state.
+ * Optionally the plugin runs oversampled: the wrapper upsamples, processes the plugin at the
+ * multiplied rate and decimates again, reporting the filters' latency to the host. MIDI event
+ * positions are scaled to the oversampled block and back.
+ */
+class PluginNodeProcessor : public juce::AudioPluginInstance, private juce::AudioProcessorListener {
+   public:
+    PluginNodeProcessor(std::unique_ptr<juce::AudioProcessor> processorToWrap,
+        TraceRecorder& traceRecorder)
+        : AudioPluginInstance(getBusesPropertiesOf(*processorToWrap)),
+          inner(std::move(processorToWrap)),
+          tracer(traceRecorder),
+          traceNameId(traceRecorder.registerName(inner->getName())) {
+        for (auto* parameter : inner->getParameters()) {
+            addHostedParameter(std::make_unique<ParameterProxy>(*parameter));
+        }
+
+        inner->addListener(this);
+    }
+
+    ~PluginNodeProcessor() override { inner->removeListener(this); }
+
+    /**
+     * Runs the plugin at 1x, 2x, 4x or 8x the graph rate. Linear phase uses FIR equiripple
+     * half-band filters, otherwise the cheaper (minimum phase) polyphase IIR ones are used.
+     * The callback lock is held while the plugin is re-prepared at the new rate, the node
+     * outputs silence until it's done.
+     */
+    void setOversampling(int factor, bool linearPhase) {
+        const juce::ScopedLock sl(getCallbackLock());
+
+        oversamplingStages = factor >= 8 ? 3 : factor >= 4 ? 2 : factor >= 2 ? 1 : 0;
+        oversamplingLinearPhase = linearPhase;
+        if (isPrepared) prepareWrapped();
+    }
+
+    int getOversamplingFactor() const { return 1 << oversamplingStages; }
+
+    void fillInPluginDescription(juce::PluginDescription& description) const override {
+        if (auto* plugin = dynamic_cast<juce::AudioPluginInstance*>(inner.get())) {
+            plugin->fillInPluginDescription(description);
+            return;
+        }
+
+        description.name = inner->getName();
+        description.descriptiveName = inner->getName();
+        description.pluginFormatName = "Internal";
+        description.numInputChannels = inner->getTotalNumInputChannels();
+        description.numOutputChannels = inner->getTotalNumOutputChannels();
+    }
+
+    void getExtensions(juce::ExtensionsVisitor& visitor) const override {
+        if (auto* plugin = dynamic_cast<juce::AudioPluginInstance*>(inner.get())) {
+            plugin->getExtensions(visitor);
+        }
+    }
+
+    void prepareToPlay(double sampleRate, int samplesPerBlock) override {
+        const juce::ScopedLock sl(getCallbackLock());
+        preparedSampleRate = sampleRate;
+        preparedBlockSize = samplesPerBlock;
+        isPrepared = true;
+        prepareWrapped();
+    }
+
+    void releaseResources() override {
+        isPrepared = false;
+        inner->releaseResources();
+    }
+
+    void reset() override {
+        inner->reset();
+        if (floatOversampler.oversampling) floatOversampler.oversampling->reset();
+        if (doubleOversampler.oversampling) doubleOversampler.oversampling->reset();
+    }
+
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override {
+        processWrapped(buffer, midi, floatOversampler);
+    }
+
+    void processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midi) override {
+        processWrapped(buffer, midi, doubleOversampler);
+    }
+
+    bool supportsDoublePrecisionProcessing() const override {
+        return inner->supportsDoublePrecisionProcessing();
+    }
+
+    void setPlayHead(juce::AudioPlayHead* newPlayHead) override {
+        AudioPluginInstance::setPlayHead(newPlayHead);
+        inner->setPlayHead(newPlayHead);
+    }
+
+    void setNonRealtime(bool isNonRealtime) noexcept override {
+        AudioPluginInstance::setNonRealtime(isNonRealtime);
+        inner->setNonRealtime(isNonRealtime);
+    }
+
+    juce::AudioProcessorParameter* getBypassParameter() const override {
+        auto* bypass = inner->getBypassParameter();
+        if (bypass == nullptr) return nullptr;
+
+        // the proxies are created in the wrapped plugin's parameter order
+        const auto index = bypass->getParameterIndex();
+        return juce::isPositiveAndBelow(index, getParameters().size()) ? getParameters()[index]
+                                                                        : nullptr;
+    }
+
+    juce::AudioProcessorEditor* createEditor() override { return inner->createEditor(); }
+    bool hasEditor() const override { return inner->hasEditor(); }
+
+    const juce::String getName() const override { return inner->getName(); }
+    bool acceptsMidi() const override { return inner->acceptsMidi(); }
+    bool producesMidi() const override { return inner->producesMidi(); }
+    bool isMidiEffect() const override { return inner->isMidiEffect(); }
+    bool supportsMPE() const override { return inner->supportsMPE(); }
+    double getTailLengthSeconds() const override { return inner->getTailLengthSeconds(); }
+
+    int getNumPrograms() override { return inner->getNumPrograms(); }
+    int getCurrentProgram() override { return inner->getCurrentProgram(); }
+    void setCurrentProgram(int index) override { inner->setCurrentProgram(index); }
+    const juce::String getProgramName(int index) override { return inner->getProgramName(index); }
+    void changeProgramName(int index, const juce::String& name) override {
+        inner->changeProgramName(index, name);
+    }
+
+    void getStateInformation(juce::MemoryBlock& data) override {
+        inner->getStateInformation(data);
+    }
+    void setStateInformation(const void* data, int size) override {
+        inner->setStateInformation(data, size);
+    }
+    void getCurrentProgramStateInformation(juce::MemoryBlock& data) override {
+        inner->getCurrentProgramStateInformation(data);
+    }
+    void setCurrentProgramStateInformation(const void* data, int size) override {
+        inner->setCurrentProgramStateInformation(data, size);
+    }
+
+   protected:
+    bool isBusesLayoutSupported(const BusesLayout& layouts) const override {
+        return inner->checkBusesLayoutSupported(layouts);
+    }
+
+    void processorLayoutsChanged() override { inner->setBusesLayout(getBusesLayout()); }
+
+   private:
+    /** Exposes one of the wrapped plugin's parameters on the node. */
+    class ParameterProxy : public HostedParameter {
+       public:
+        explicit ParameterProxy(juce::AudioProcessorParameter& parameterToWrap)
+            : wrapped(parameterToWrap) {}
+
+        juce::String getParameterID() const override {
+            if (auto* hosted = dynamic_cast<HostedParameter*>(&wrapped)) {
+                return hosted->getParameterID();
+            }
+            if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*>(&wrapped)) {
+                return withId->paramID;
+            }
+            return juce::String(wrapped.getParameterIndex());
+        }
+
+        float getValue() const override { return wrapped.getValue(); }
+        void setValue(float newValue) override { wrapped.setValue(newValue); }
+        float getDefaultValue() const override { return wrapped.getDefaultValue(); }
+        juce::String getName(int maximumLength) const override {
+            return wrapped.getName(maximumLength);
+        }
+        juce::String getLabel() const override { return wrapped.getLabel(); }
+        juce::String getText(float value, int maximumLength) const override {
+            return wrapped.getText(value, maximumLength);
+        }
+        float getValueForText(const juce::String& text) const override {
+            return wrapped.getValueForText(text);
+        }
+        int getNumSteps() const override { return wrapped.getNumSteps(); }
+        bool isDiscrete() const override { return wrapped.isDiscrete(); }
+        bool isBoolean() const override { return wrapped.isBoolean(); }
+        bool isOrientationInverted() const override { return wrapped.isOrientationInverted(); }
+        bool isAutomatable() const override { return wrapped.isAutomatable(); }
+        bool isMetaParameter() const override { return wrapped.isMetaParameter(); }
+        Category getCategory() const override { return wrapped.getCategory(); }
+        juce::StringArray getAllValueStrings() const override {
+            return wrapped.getAllValueStrings();
+        }
+
+       private:
+        juce::AudioProcessorParameter& wrapped;
+    };
+
+    template <typename Sample>
+    struct Oversampler {
+        std::unique_ptr<juce::dsp::Oversampling<Sample>> oversampling;
+        std::vector<Sample*> channels;
+    };
+
+    std::unique_ptr<juce::AudioProcessor> inner;
+    TraceRecorder& tracer;
+    const juce::uint32 traceNameId;
+
+    int oversamplingStages = 0;
+    bool oversamplingLinearPhase = false;
+    Oversampler<float> floatOversampler;
+    Oversampler<double> doubleOversampler;
+    juce::MidiBuffer oversampledMidi;
+
+    // updateLatency() can run on any thread the plugin reports from, so the oversampling state
+    // it needs is published separately under a lock
+    juce::CriticalSection latencyLock;
+    int latencyFactor = 1;
+    float oversamplingLatency = 0.0f;
+
+    double preparedSampleRate = 44100.0;
+    int preparedBlockSize = 512;
+    bool isPrepared = false;
+
+    static BusesProperties getBusesPropertiesOf(const juce::AudioProcessor& processor) {
+        BusesProperties buses;
+        for (bool isInput : {true, false}) {
+            for (int i = 0; i < processor.getBusCount(isInput); ++i) {
+                auto* bus = processor.getBus(isInput, i);
+                buses.addBus(
+                    isInput, bus->getName(), bus->getLastEnabledLayout(), bus->isEnabled());
+            }
+        }
+        return buses;
+    }
+
+    template <typename Sample>
+    void processWrapped(juce::AudioBuffer<Sample>& buffer,
+        juce::MidiBuffer& midi,
+        Oversampler<Sample>& oversampler) {
+        const TraceRecorder::Scope scope(
+            tracer, traceNameId, TraceEventType::nodeProcess, TraceSource::audio);
+
+        // the graph doesn't take the node's callback lock, so the oversamplers and the plugin
+        // could be rebuilt under a block that's already running; never wait for it here though
+        const juce::ScopedTryLock sl(getCallbackLock());
+        if (!sl.isLocked() || isSuspended()) {
+            buffer.clear();
+            midi.clear();
+            return;
+        }
+
+        if (!oversampler.oversampling) {
+            inner->processBlock(buffer, midi);
+            return;
+        }
+
+        const int numChannels =
+            juce::jmin(buffer.getNumChannels(), static_cast<int>(oversampler.channels.size()));
+        juce::dsp::AudioBlock<Sample> block(buffer.getArrayOfWritePointers(),
+            static_cast<size_t>(numChannels),
+            static_cast<size_t>(buffer.getNumSamples()));
+
+        auto oversampledBlock = oversampler.oversampling->processSamplesUp(block);
+        for (int channel = 0; channel < numChannels; ++channel) {
+            oversampler.channels[channel] = oversampledBlock.getChannelPointer(channel);
+        }
+
+        // refers to the oversampler's memory, nothing is allocated here
+        juce::AudioBuffer<Sample> oversampledBuffer(oversampler.channels.data(),
+            numChannels,
+            static_cast<int>(oversampledBlock.getNumSamples()));
+
+        // the plugin sees a block factor times longer, so do the events' positions
+        const auto factor = static_cast<int>(oversampler.oversampling->getOversamplingFactor());
+        oversampledMidi.clear();
+        for (const auto metadata : midi) {
+            oversampledMidi.addEvent(
+                metadata.data, metadata.numBytes, metadata.samplePosition * factor);
+        }
+
+        inner->processBlock(oversampledBuffer, oversampledMidi);
+
+        midi.clear();
+        for (const auto metadata : oversampledMidi) {
+            midi.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition / factor);
+        }
+
+        oversampler.oversampling->processSamplesDown(block);
+    }
+
+    /** Returns the filters' latency, in samples at the graph rate. */
+    template <typename Sample>
+    float prepareOversampler(Oversampler<Sample>& oversampler, bool active, int numChannels) {
+        oversampler.oversampling = nullptr;
+        oversampler.channels.assign(static_cast<size_t>(numChannels), nullptr);
+        if (!active || oversamplingStages == 0) return 0.0f;
+
+        auto filterType = oversamplingLinearPhase
+                              ? juce::dsp::Oversampling<Sample>::filterHalfBandFIREquiripple
+                              : juce::dsp::Oversampling<Sample>::filterHalfBandPolyphaseIIR;
+
+        // integer latency, so it can be compensated exactly by the graph
+        oversampler.oversampling = std::make_unique<juce::dsp::Oversampling<Sample>>(
+            static_cast<size_t>(numChannels),
+            static_cast<size_t>(oversamplingStages),
+            filterType,
+            true,
+            true);
+        oversampler.oversampling->initProcessing(static_cast<size_t>(preparedBlockSize));
+        return static_cast<float>(oversampler.oversampling->getLatencyInSamples());
+    }
+
+    void prepareWrapped() {
+        const int numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+        const int factor = 1 << oversamplingStages;
+        const auto precision = getProcessingPrecision();
+
+        oversampledMidi.ensureSize(2048);
+        const auto filterLatency =
+            prepareOversampler(floatOversampler, precision == singlePrecision, numChannels)
+            + prepareOversampler(doubleOversampler, precision == doublePrecision, numChannels);
+
+        inner->setProcessingPrecision(precision);
+        inner->setRateAndBufferSizeDetails(
+            preparedSampleRate * factor, preparedBlockSize * factor);
+        inner->prepareToPlay(preparedSampleRate * factor, preparedBlockSize * factor);
+
+        {
+            const juce::ScopedLock sl(latencyLock);
+            latencyFactor = factor;
+            oversamplingLatency = filterLatency;
+        }
+        updateLatency();
+    }
+
+    void updateLatency() {
+        float latency;
+        {
+            // the plugin reports its latency in oversampled samples
+            const juce::ScopedLock sl(latencyLock);
+            latency = static_cast<float>(inner->getLatencySamples())
+                          / static_cast<float>(latencyFactor)
+                      + oversamplingLatency;
+        }
+
+        setLatencySamples(juce::roundToInt(latency));
+    }
+
+    void audioProcessorParameterChanged(juce::AudioProcessor*, int index, float value) override {
+        // keeps listeners of the node in sync with changes made by the plugin itself
+        if (auto* proxy = getParameters()[index]) proxy->sendValueChangedMessageToListeners(value);
+    }
+
+    void audioProcessorParameterChangeGestureBegin(juce::AudioProcessor*, int index) override {
+        if (auto* proxy = getParameters()[index]) proxy->beginChangeGesture();
+    }
+
+    void audioProcessorParameterChangeGestureEnd(juce::AudioProcessor*, int index) override {
+        if (auto* proxy = getParameters()[index]) proxy->endChangeGesture();
+    }
+
+    void audioProcessorChanged(juce::AudioProcessor*, const ChangeDetails& details) override {
+        // keeps the graph's latency compensation in sync with the plugin
+        if (details.latencyChanged) updateLatency();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginNodeProcessor)
+};
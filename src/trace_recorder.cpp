@@ -0,0 +1,202 @@
+#include "trace_recorder.h"
+
+TraceRecorder::TraceRecorder() : juce::Thread("TraceRecorder") {
+    audioCallbackNameId = registerName("Audio callback");
+    graphUpdateNameId = registerName("Update graph");
+}
+
+TraceRecorder::~TraceRecorder() { stop(); }
+
+bool TraceRecorder::start(const juce::File& file) {
+    stop();
+
+    auto newStream = std::make_unique<juce::FileOutputStream>(file);
+    if (!newStream->openedOk()) {
+        std::cerr << "Cannot open trace file: " << file.getFullPathName() << std::endl;
+        return false;
+    }
+
+    newStream->setPosition(0);
+    newStream->truncate();
+    newStream->writeInt(static_cast<int>(fileMagic));
+    newStream->writeInt(static_cast<int>(fileVersion));
+    newStream->writeInt64(juce::Time::getHighResolutionTicksPerSecond());
+
+    stream = std::move(newStream);
+    traceFile = file;
+
+    {
+        const juce::ScopedLock sl(namesLock);
+        namesWritten = 0;
+    }
+
+    // a producer that passed the isRecording() check before the last stop() may still be
+    // writing, and AbstractFifo can't be reset under a writer, so stale events are read away
+    for (auto* ring : {&audioRing, &messageRing}) {
+        ring->fifo.read(ring->fifo.getNumReady());
+        ring->dropped.store(0);
+    }
+
+    recording.store(true);
+    startThread();
+
+    std::cout << "Trace recording started: " << file.getFullPathName() << std::endl;
+    return true;
+}
+
+void TraceRecorder::stop() {
+    if (!recording.exchange(false)) return;
+
+    stopThread(1000);
+    flush();
+    stream->flush();
+    stream = nullptr;
+
+    std::cout << "Trace recording stopped, dropped events: "
+              << audioRing.dropped.load() + messageRing.dropped.load() << std::endl;
+}
+
+juce::uint32 TraceRecorder::registerName(const juce::String& name) {
+    const juce::ScopedLock sl(namesLock);
+
+    auto index = names.indexOf(name);
+    if (index < 0) {
+        index = names.size();
+        names.add(name);
+    }
+
+    return static_cast<juce::uint32>(index);
+}
+
+void TraceRecorder::addEvent(const Event& event) {
+    if (!isRecording()) return;
+
+    auto& ring = event.source == TraceSource::audio ? audioRing : messageRing;
+    const auto scope = ring.fifo.write(1);
+
+    // a full ring drops the event rather than blocking the producer
+    if (scope.blockSize1 > 0) {
+        ring.events[static_cast<size_t>(scope.startIndex1)] = event;
+    } else {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TraceRecorder::run() {
+    while (!threadShouldExit()) {
+        flush();
+        wait(50);
+    }
+}
+
+void TraceRecorder::flush() {
+    {
+        const juce::ScopedLock sl(namesLock);
+        for (; namesWritten < names.size(); ++namesWritten) {
+            stream->writeByte(static_cast<char>(nameRecord));
+            stream->writeInt(namesWritten);
+            stream->writeString(names[namesWritten]);
+        }
+    }
+
+    drain(audioRing);
+    drain(messageRing);
+}
+
+void TraceRecorder::drain(Ring& ring) {
+    const auto scope = ring.fifo.read(ring.fifo.getNumReady());
+
+    scope.forEach([this, &ring](int index) {
+        const auto& event = ring.events[static_cast<size_t>(index)];
+        stream->writeByte(static_cast<char>(eventRecord));
+        stream->writeInt64(event.startTicks);
+        stream->writeInt64(event.endTicks);
+        stream->writeInt(static_cast<int>(event.nameId));
+        stream->writeByte(static_cast<char>(event.type));
+        stream->writeByte(static_cast<char>(event.source));
+    });
+}
+
+bool TraceRecorder::convertToChromeJson(const juce::File& traceFile, const juce::File& jsonFile) {
+    juce::FileInputStream in(traceFile);
+    if (!in.openedOk()) return false;
+
+    if (in.readInt() != static_cast<int>(fileMagic) ||
+        in.readInt() != static_cast<int>(fileVersion)) {
+        std::cerr << "Not a trace file: " << traceFile.getFullPathName() << std::endl;
+        return false;
+    }
+
+    const auto ticksPerSecond = static_cast<double>(in.readInt64());
+    juce::StringArray nameTable;
+    std::vector<Event> events;
+
+    while (!in.isExhausted()) {
+        auto record = static_cast<juce::uint8>(in.readByte());
+
+        if (record == nameRecord) {
+            auto id = in.readInt();
+            auto name = in.readString();
+            while (nameTable.size() <= id) nameTable.add({});
+            nameTable.set(id, name);
+        } else if (record == eventRecord) {
+            Event event;
+            event.startTicks = in.readInt64();
+            event.endTicks = in.readInt64();
+            event.nameId = static_cast<juce::uint32>(in.readInt());
+            event.type = static_cast<TraceEventType>(in.readByte());
+            event.source = static_cast<TraceSource>(in.readByte());
+            events.push_back(event);
+        } else {
+            std::cerr << "Corrupted trace file: " << traceFile.getFullPathName() << std::endl;
+            return false;
+        }
+    }
+
+    juce::FileOutputStream out(jsonFile);
+    if (!out.openedOk()) return false;
+
+    out.setPosition(0);
+    out.truncate();
+
+    static const char* const categories[] = {
+        "audio_callback", "node_process", "graph_update", "plugin_instantiate", "editor_open"};
+
+    auto origin = events.empty() ? 0 : events.front().startTicks;
+    for (const auto& event : events) origin = juce::jmin(origin, event.startTicks);
+
+    auto toMicroseconds = [ticksPerSecond](juce::int64 ticks) {
+        return juce::String(static_cast<double>(ticks) * 1.0e6 / ticksPerSecond, 3);
+    };
+
+    auto writeThreadName = [&out](TraceSource source, const char* name) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << static_cast<int>(source) << ",\"args\":{\"name\":\"" << name << "\"}}";
+    };
+
+    out << "{\"traceEvents\":[\n";
+    writeThreadName(TraceSource::audio, "Audio");
+    out << ",\n";
+    writeThreadName(TraceSource::message, "Message");
+
+    for (const auto& event : events) {
+        auto name = juce::isPositiveAndBelow(static_cast<int>(event.nameId), nameTable.size())
+                        ? nameTable[static_cast<int>(event.nameId)]
+                        : juce::String("unknown");
+
+        auto type = static_cast<int>(event.type);
+        auto category = juce::isPositiveAndBelow(type, juce::numElementsInArray(categories))
+                            ? categories[type]
+                            : "unknown";
+
+        out << ",\n{\"name\":\"" << juce::JSON::escapeString(name) << "\",\"cat\":\"" << category
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << static_cast<int>(event.source)
+            << ",\"ts\":" << toMicroseconds(event.startTicks - origin)
+            << ",\"dur\":" << toMicroseconds(event.endTicks - event.startTicks) << "}";
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.flush();
+
+    return true;
+}
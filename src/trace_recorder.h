@@ -0,0 +1,115 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+
+enum class TraceEventType : juce::uint8 {
+    audioCallback,
+    nodeProcess,
+    graphUpdate,
+    pluginInstantiate,
+    editorOpen,
+};
+
+// which producer recorded the event, also used as the thread id in the exported trace
+enum class TraceSource : juce::uint8 { audio, message };
+
+/**
+ * Low overhead performance trace. Spans are written into pre-allocated lock-free rings (one
+ * per producing thread) and a background thread flushes them into a compact binary file,
+ * which convertToChromeJson turns into Chrome/Perfetto trace JSON.
+ * When not recording, adding an event is a single atomic load.
+ */
+class TraceRecorder : private juce::Thread {
+   public:
+    struct Event {
+        juce::int64 startTicks;
+        juce::int64 endTicks;
+        juce::uint32 nameId;
+        TraceEventType type;
+        TraceSource source;
+    };
+
+    /**
+     * Records the lifetime of the scope as one span
+     */
+    class Scope {
+       public:
+        Scope(TraceRecorder& recorder, juce::uint32 nameId, TraceEventType type, TraceSource source)
+            : tracer(recorder),
+              event{recorder.isRecording() ? juce::Time::getHighResolutionTicks() : 0,
+                  0,
+                  nameId,
+                  type,
+                  source} {}
+
+        ~Scope() {
+            if (event.startTicks != 0) {
+                event.endTicks = juce::Time::getHighResolutionTicks();
+                tracer.addEvent(event);
+            }
+        }
+
+       private:
+        TraceRecorder& tracer;
+        Event event;
+
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+    TraceRecorder();
+    ~TraceRecorder() override;
+
+    bool start(const juce::File& file);
+    void stop();
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+    juce::File getFile() const { return traceFile; }
+
+    /**
+     * Returns the id for the given span name, registering it if needed. Message thread only,
+     * so the audio thread can use ids that were handed out beforehand.
+     */
+    juce::uint32 registerName(const juce::String& name);
+
+    void addEvent(const Event& event);
+
+    juce::uint32 getAudioCallbackNameId() const { return audioCallbackNameId; }
+    juce::uint32 getGraphUpdateNameId() const { return graphUpdateNameId; }
+
+    static bool convertToChromeJson(const juce::File& traceFile, const juce::File& jsonFile);
+
+   private:
+    struct Ring {
+        explicit Ring(int capacity) : fifo(capacity), events(static_cast<size_t>(capacity)) {}
+
+        juce::AbstractFifo fifo;
+        std::vector<Event> events;
+        std::atomic<juce::uint32> dropped{0};
+    };
+
+    static constexpr juce::uint32 fileMagic = 0x5452414d;  // "MART"
+    static constexpr juce::uint32 fileVersion = 1;
+    static constexpr juce::uint8 eventRecord = 1;
+    static constexpr juce::uint8 nameRecord = 2;
+
+    std::atomic<bool> recording{false};
+    Ring audioRing{1 << 16};
+    Ring messageRing{1 << 12};
+
+    juce::CriticalSection namesLock;
+    juce::StringArray names;
+    int namesWritten = 0;
+
+    juce::File traceFile;
+    std::unique_ptr<juce::FileOutputStream> stream;
+
+    juce::uint32 audioCallbackNameId = 0;
+    juce::uint32 graphUpdateNameId = 0;
+
+    void run() override;
+    void flush();
+    void drain(Ring& ring);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TraceRecorder)
+};
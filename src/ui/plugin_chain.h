@@ -5,72 +5,69 @@
 #include <math.h>
 
 #include "plugin_host.h"
+#include "plugin_window.h"
 
+/**
+ * Row component of the plugin list. Rows are recycled by the list box, so an item is
+ * re-pointed at another entry through setEntry instead of being recreated.
+ */
 class PluginListItem : public juce::Component {
    public:
-    PluginListItem(PluginEntry& e,
-        std::function<void()> onSelect,
-        std::function<void(bool state)> onBypass,
-        bool isBypass,
-        bool isSelected)
-        : plugin(e),
-          onSelectCallback(onSelect),
-          onBypassCallback(onBypass),
-          bypass(isBypass),
-          selected(isSelected) {
-        nameLabel.setText(plugin.name, juce::dontSendNotification);
-        nameLabel.setInterceptsMouseClicks(false, true);
+    PluginListItem(std::function<void(int row, bool state)> onBypass)
+        : onBypassCallback(onBypass) {
+        // clicks outside the bypass button go to the list box, which handles selection
+        setInterceptsMouseClicks(false, true);
+
+        nameLabel.setInterceptsMouseClicks(false, false);
         addAndMakeVisible(nameLabel);
 
-        toggleButton.setButtonText(bypass ? "enable" : "bypass");
         toggleButton.onClick = [this]() {
             bypass = !bypass;
             toggleButton.setButtonText(bypass ? "enable" : "bypass");
-            onBypassCallback(bypass);
+            onBypassCallback(row, bypass);
         };
         addAndMakeVisible(toggleButton);
     }
 
+    void setEntry(const PluginEntry& plugin, int rowNumber) {
+        row = rowNumber;
+        bypass = plugin.bypass;
+
+        auto label = plugin.name;
+        if (plugin.oversamplingFactor > 1) {
+            label << " [" << plugin.oversamplingFactor << "x"
+                  << (plugin.oversamplingLinearPhase ? ", linear" : "") << "]";
+        }
+        nameLabel.setText(label, juce::dontSendNotification);
+        toggleButton.setButtonText(bypass ? "enable" : "bypass");
+    }
+
     void resized() override {
         auto area = getLocalBounds().reduced(4);
         toggleButton.setBounds(area.removeFromRight(80));
         nameLabel.setBounds(area);
     }
 
-    void paint(juce::Graphics& g) override {
-        g.fillAll(selected ? juce::Colours::darkblue.withAlpha(0.5f) : juce::Colours::darkgrey);
-        g.setColour(juce::Colours::black);
-        g.drawRect(getLocalBounds(), 1);
-    }
-
-    void mouseUp(const juce::MouseEvent& event) override {
-        if (onSelectCallback) {
-            onSelectCallback();
-        }
-    }
-
    private:
-    PluginEntry& plugin;
     juce::Label nameLabel;
-    juce::TextButton toggleButton, selectButton;
-    std::function<void()> onSelectCallback;
-    std::function<void(bool state)> onBypassCallback;
-    bool selected;
-    bool bypass;
+    juce::TextButton toggleButton;
+    std::function<void(int row, bool state)> onBypassCallback;
+    int row = -1;
+    bool bypass = false;
 };
 
 /**
  * Component that displays a list of plugins in the chain.
- * Each plugin is represented by a PluginListItem.
+ * The list box only creates components for visible rows and reuses them, and plugin editors are
+ * cached in their PluginEntry, so selecting, moving or reopening doesn't rebuild anything.
  */
-class PluginChainUI : public juce::Component {
+class PluginChainUI : public juce::Component, private juce::ListBoxModel {
    public:
-    PluginChainUI(PluginHost& parentPluginHost)
-        : pluginHost(parentPluginHost), pluginChain(parentPluginHost.getPluginEntries()) {
-        addAndMakeVisible(viewport);
-        pluginListContent.reset(new juce::Component());
-        viewport.setViewedComponent(pluginListContent.get(), false);
-        viewport.setScrollBarsShown(true, false);
+    PluginChainUI(PluginHost& parentPluginHost) : pluginHost(parentPluginHost) {
+        listBox.setModel(this);
+        listBox.setRowHeight(itemHeight);
+        listBox.setColour(juce::ListBox::backgroundColourId, juce::Colours::transparentBlack);
+        addAndMakeVisible(listBox);
 
         addButton.setButtonText("Add Plugin");
         addButton.onClick = [this]() {
@@ -80,8 +77,9 @@ class PluginChainUI : public juce::Component {
 
         showPluginButton.setButtonText("Show Plugin");
         showPluginButton.onClick = [this]() {
-            if (selectedIndex < 0 || selectedIndex >= pluginChain.size()) return;
-            auto& selectedEntry = pluginChain[selectedIndex];
+            auto selectedIndex = listBox.getSelectedRow();
+            if (selectedIndex < 0 || selectedIndex >= chain().size()) return;
+            auto& selectedEntry = chain()[selectedIndex];
             if (selectedEntry) {
                 this->showPluginContent(*selectedEntry);
             }
@@ -90,64 +88,54 @@ class PluginChainUI : public juce::Component {
 
         removeButton.setButtonText("Delete Plugin");
         removeButton.onClick = [this]() {
-            pluginHost.removePlugin(selectedIndex);
-            if (selectedIndex >= pluginChain.size()) {
-                selectedIndex = pluginChain.size() - 1;
-            } else if (selectedIndex - 1 >= 0) {
-                selectedIndex--;
+            auto selectedIndex = listBox.getSelectedRow();
+            if (selectedIndex < 0 || selectedIndex >= chain().size()) return;
+
+            // the host destroys the cached editor, so the window must let go of it first
+            if (pluginEditorEntry == chain()[selectedIndex].get()) {
+                closePluginContent();
             }
+
+            pluginHost.removePlugin(selectedIndex);
             refreshList();
+            listBox.selectRow(juce::jmin(selectedIndex, static_cast<int>(chain().size()) - 1));
         };
         addAndMakeVisible(removeButton);
 
+        oversampleButton.setButtonText("Oversample");
+        oversampleButton.onClick = [this]() {
+            showOversamplingMenu();
+        };
+        addAndMakeVisible(oversampleButton);
+
         moveUpButton.setButtonText("Move Up");
         addAndMakeVisible(moveUpButton);
         moveUpButton.onClick = [this]() {
-            int newIndex = std::max(0.0, static_cast<double>(selectedIndex - 1));
-            pluginHost.movePlugin(selectedIndex, newIndex);
-            selectedIndex = newIndex;
-            refreshList();
+            moveSelectedPlugin(-1);
         };
 
         moveDownButton.setButtonText("Move Down");
         addAndMakeVisible(moveDownButton);
         moveDownButton.onClick = [this]() {
-            int newIndex = std::min(static_cast<double>(pluginHost.getPluginEntries().size() - 1),
-                static_cast<double>(selectedIndex + 1));
-            pluginHost.movePlugin(selectedIndex, newIndex);
-            selectedIndex = newIndex;
-            refreshList();
+            moveSelectedPlugin(1);
         };
 
         refreshList();
     }
 
-    void refreshList() {
-        pluginListContent->removeAllChildren();
-        for (size_t i = 0; i < pluginChain.size(); ++i) {
-            int idx = static_cast<int>(i);
-
-            auto& entry = pluginChain[i];
-            auto* item = new PluginListItem(
-                *entry,
-                [this, i]() {
-                    if (selectedIndex == static_cast<int>(i)) return;
-                    selectedIndex = static_cast<int>(i);
-                    this->refreshList();
-                },
-                [this, i](bool state) {
-                    pluginHost.bypassPlugin(i, state);
-                },
-                entry->bypass,
-                selectedIndex == idx);
-
-            pluginListContent->addAndMakeVisible(item);
-            item->setBounds(0, idx * this->itemHeight, this->itemWidth, this->itemHeight);
-        }
+    ~PluginChainUI() override { closePluginContent(); }
 
-        pluginListContent->resized();
-        viewport.repaint();
-        resized();
+    /**
+     * Updates the visible rows from the edited chain, reusing their components
+     */
+    void refreshList() { listBox.updateContent(); }
+
+    /**
+     * Called when the host starts editing another chain slot
+     */
+    void editedChainChanged() {
+        listBox.deselectAllRows();
+        refreshList();
     }
 
     void paint(juce::Graphics& g) override { g.fillAll(static_cast<juce::Colour>(0xFF2a2a2a)); }
@@ -155,38 +143,72 @@ class PluginChainUI : public juce::Component {
     void resized() override {
         auto area = getLocalBounds();
         auto controlArea = area.removeFromBottom(40).reduced(4);
-        int btnWidth = controlArea.getWidth() / 5;
+        int btnWidth = controlArea.getWidth() / 6;
 
         addButton.setBounds(controlArea.removeFromLeft(btnWidth));
         showPluginButton.setBounds(controlArea.removeFromLeft(btnWidth));
         removeButton.setBounds(controlArea.removeFromLeft(btnWidth));
+        oversampleButton.setBounds(controlArea.removeFromLeft(btnWidth));
         moveUpButton.setBounds(controlArea.removeFromLeft(btnWidth));
         moveDownButton.setBounds(controlArea);
 
-        int listHeight = static_cast<int>(pluginChain.size()) * itemHeight;
-
-        pluginListContent->setSize(this->itemWidth, listHeight);
-
-        auto viewportArea = area.removeFromLeft(this->itemWidth + 4);
-        viewport.setBounds(viewportArea);
+        listBox.setBounds(area.removeFromLeft(this->itemWidth + 4));
     }
 
    private:
     static constexpr int itemHeight = 34;
     static constexpr int itemWidth = 300;
-    static constexpr int itemMargin = 4;
-    static constexpr int viewportWidth = 300;
-    static constexpr int viewportHeight = 400;
 
-    int selectedIndex = -1;
-
-    juce::Viewport viewport;
     PluginHost& pluginHost;
-    std::vector<std::unique_ptr<PluginEntry>>& pluginChain;
+    juce::ListBox listBox;
     std::map<int, juce::PluginDescription> vstPluginMap;
-    std::unique_ptr<juce::Component> pluginListContent;
     std::unique_ptr<PluginEditorWindow> pluginEditorWindow;
-    juce::TextButton addButton, showPluginButton, removeButton, moveUpButton, moveDownButton;
+    PluginEntry* pluginEditorEntry = nullptr;
+    juce::TextButton addButton, showPluginButton, removeButton, oversampleButton, moveUpButton,
+        moveDownButton;
+
+    // the host returns whichever chain is currently being edited
+    std::vector<std::unique_ptr<PluginEntry>>& chain() { return pluginHost.getPluginEntries(); }
+
+    int getNumRows() override { return static_cast<int>(chain().size()); }
+
+    void paintListBoxItem(int, juce::Graphics& g, int width, int height, bool selected) override {
+        g.fillAll(selected ? juce::Colours::darkblue.withAlpha(0.5f) : juce::Colours::darkgrey);
+        g.setColour(juce::Colours::black);
+        g.drawRect(0, 0, width, height, 1);
+    }
+
+    juce::Component* refreshComponentForRow(int row,
+        bool,
+        juce::Component* existingComponentToUpdate) override {
+        auto* item = dynamic_cast<PluginListItem*>(existingComponentToUpdate);
+
+        if (row < 0 || row >= chain().size()) {
+            // the list box only owns the component that is returned, a component passed in
+            // that isn't handed back must be deleted here
+            delete item;
+            return nullptr;
+        }
+
+        if (item == nullptr) {
+            item = new PluginListItem([this](int bypassedRow, bool state) {
+                pluginHost.bypassPlugin(bypassedRow, state);
+            });
+        }
+
+        item->setEntry(*chain()[row], row);
+        return item;
+    }
+
+    void moveSelectedPlugin(int offset) {
+        auto selectedIndex = listBox.getSelectedRow();
+        auto newIndex = selectedIndex + offset;
+        if (selectedIndex < 0 || newIndex < 0 || newIndex >= chain().size()) return;
+
+        pluginHost.movePlugin(selectedIndex, newIndex);
+        refreshList();
+        listBox.selectRow(newIndex);
+    }
 
     void showPluginMenu() {
         vstPluginMap.clear();
@@ -212,9 +234,53 @@ class PluginChainUI : public juce::Component {
                 auto it = vstPluginMap.find(result);
                 if (it != vstPluginMap.end()) {
                     const juce::PluginDescription& desc = it->second;
-                    pluginHost.addPlugin(desc, -1);
-                    refreshList();
+                    pluginHost.addPluginAsync(desc,
+                        pluginHost.getEditedChain(),
+                        [safeThis = juce::Component::SafePointer<PluginChainUI>(this)](bool) {
+                            if (safeThis) safeThis->refreshList();
+                        });
+                }
+            });
+    }
+
+    void showOversamplingMenu() {
+        auto selectedIndex = listBox.getSelectedRow();
+        if (selectedIndex < 0 || selectedIndex >= chain().size()) return;
+        auto& entry = *chain()[selectedIndex];
+
+        // item id encodes the factor, +100 for the linear phase variants
+        juce::PopupMenu menu;
+        menu.addItem(1, "Off", true, entry.oversamplingFactor == 1);
+        for (int factor : {2, 4, 8}) {
+            menu.addItem(factor,
+                juce::String(factor) + "x minimum phase",
+                true,
+                entry.oversamplingFactor == factor && !entry.oversamplingLinearPhase);
+            menu.addItem(factor + 100,
+                juce::String(factor) + "x linear phase",
+                true,
+                entry.oversamplingFactor == factor && entry.oversamplingLinearPhase);
+        }
+
+        // the list can change while the menu is open, so the entry is looked up again by pointer
+        menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(oversampleButton),
+            [safeThis = juce::Component::SafePointer<PluginChainUI>(this),
+                target = &entry](int result) {
+                if (result == 0 || !safeThis) {
+                    return;
                 }
+
+                auto& entries = safeThis->chain();
+                auto it = std::find_if(entries.begin(), entries.end(), [target](const auto& e) {
+                    return e.get() == target;
+                });
+                if (it == entries.end()) return;
+
+                safeThis->pluginHost.setPluginOversampling(
+                    static_cast<int>(std::distance(entries.begin(), it)),
+                    result % 100,
+                    result > 100);
+                safeThis->refreshList();
             });
     }
 
@@ -224,20 +290,34 @@ class PluginChainUI : public juce::Component {
             return;
         }
 
-        if (pluginEditorWindow) {
-            // If the current plugin is reopened, its window must be destroyed and freed
-            // Probably not the best way to do this, but it works so...
-            pluginEditorWindow = nullptr;
+        // the editor is created once and kept in the entry, reopening only shows it again
+        if (!entry.editor) {
+            auto& tracer = pluginHost.getTraceRecorder();
+            const TraceRecorder::Scope scope(tracer,
+                tracer.registerName("Open editor " + entry.name),
+                TraceEventType::editorOpen,
+                TraceSource::message);
+
+            entry.editor.reset(entry.node->getProcessor()->createEditor());
         }
 
-        auto editor = entry.node->getProcessor()->createEditor();
-        if (editor) {
-            pluginEditorWindow = std::make_unique<PluginEditorWindow>(editor);
-            pluginEditorWindow->setSize(600, 300);
-            pluginEditorWindow->setOpaque(true);
-            pluginEditorWindow->setVisible(true);
-        } else {
+        if (!entry.editor) {
             std::cout << "Plugin doesn't have an editor" << std::endl;
+            return;
         }
+
+        if (!pluginEditorWindow) {
+            pluginEditorWindow = std::make_unique<PluginEditorWindow>();
+        }
+
+        pluginEditorWindow->showEditor(entry.editor.get(), entry.name);
+        pluginEditorEntry = &entry;
+    }
+
+    void closePluginContent() {
+        if (pluginEditorWindow) {
+            pluginEditorWindow->clearEditor();
+        }
+        pluginEditorEntry = nullptr;
     }
-};
\ No newline at end of file
+};
@@ -3,28 +3,39 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_gui_basics/juce_gui_basics.h>
 
+/**
+ * Window that shows plugin editors. Editors are owned by their PluginEntry, the window only
+ * borrows them, so switching between plugins or closing the window never destroys an editor.
+ */
 class PluginEditorWindow : public juce::DocumentWindow {
    public:
-    PluginEditorWindow(juce::AudioProcessorEditor* pluginEditor)
+    PluginEditorWindow()
         : juce::DocumentWindow(
               "Plugin Editor", juce::Colours::darkgrey, juce::DocumentWindow::allButtons) {
         setUsingNativeTitleBar(true);
         setResizable(true, false);
         setSize(800, 600);
-        setContentOwned(pluginEditor, true);
-
-        centreWithSize(getWidth(), getHeight());
-        setVisible(true);
     }
 
     ~PluginEditorWindow() override {
+        clearContentComponent();
         std::cout << "PluginEditorWindow destructor called" << std::endl;
     }
 
-    void setEditor(juce::AudioProcessorEditor* newEditor) {
-        setContentOwned(newEditor, true);  // takes ownership and deletes the old one
-        centreWithSize(newEditor->getWidth(), newEditor->getHeight());
+    void showEditor(juce::AudioProcessorEditor* editor, const juce::String& title) {
+        if (getContentComponent() != editor) {
+            setContentNonOwned(editor, true);  // resizes the window to the editor
+            centreWithSize(getWidth(), getHeight());
+        }
+
+        setName(title);
         setVisible(true);
+        toFront(true);
+    }
+
+    void clearEditor() {
+        clearContentComponent();
+        setVisible(false);
     }
 
     void closeButtonPressed() override { setVisible(false); }